@@ -46,7 +46,8 @@ const facilio_examples = [_][]const u8{
     "examples/http-hello.c",
 };
 
-const server_comp_flags = [_][]const u8{ "-Weverything", "-pthread" };
+// Frame pointers keep the stacks of the built-in profiler accurate.
+const server_comp_flags = [_][]const u8{ "-Weverything", "-pthread", "-fno-omit-frame-pointer" };
 const client_comp_flags = [_][]const u8{"-pthread"};
 
 // Although this function looks imperative, note that its job is to
@@ -166,12 +167,60 @@ pub fn build(b: *std.Build) !void {
     const test_client_run = b.step("test_client", "Run the testing client");
     test_client_run.dependOn(&test_client_cmd.step);
 
+    const load_client_exe = b.addExecutable(.{
+        .name = "load_client",
+        .target = target,
+        .optimize = optimize,
+    });
+    load_client_exe.addCSourceFile(.{
+        .file = .{ .cwd_relative = "src/load_client.c" },
+        .flags = &server_comp_flags,
+    });
+    load_client_exe.linkLibC();
+    load_client_exe.linkLibrary(facilio);
+    for (facilio_includes) |dep_path| {
+        load_client_exe.addIncludePath(facilio_dep.path(dep_path));
+    }
+    b.installArtifact(load_client_exe);
+
+    const load_client_cmd = b.addRunArtifact(load_client_exe);
+    if (b.args) |args| {
+        load_client_cmd.addArgs(args);
+    }
+    const load_client_run = b.step("load_client", "Run the load generator");
+    load_client_run.dependOn(&load_client_cmd.step);
+
+    const bench_exe = b.addExecutable(.{
+        .name = "bench",
+        .target = target,
+        .optimize = optimize,
+    });
+    bench_exe.addCSourceFile(.{
+        .file = .{ .cwd_relative = "src/bench.c" },
+        .flags = &server_comp_flags,
+    });
+    bench_exe.linkLibC();
+    bench_exe.linkLibrary(facilio);
+    for (facilio_includes) |dep_path| {
+        bench_exe.addIncludePath(facilio_dep.path(dep_path));
+    }
+    b.installArtifact(bench_exe);
+
+    const bench_cmd = b.addRunArtifact(bench_exe);
+    if (b.args) |args| {
+        bench_cmd.addArgs(args);
+    }
+    const bench_run = b.step("bench", "Run the data structure microbenchmarks");
+    bench_run.dependOn(&bench_cmd.step);
+
     // First we create the basic executable
     const exe = b.addExecutable(.{
         .name = "uwuchat_server",
         .target = target,
         .optimize = optimize,
     });
+    // Exports all symbols so the built-in profiler can name every function.
+    exe.rdynamic = true;
     // Since we need to use printf and stuff
     // We need the libC library.
     exe.linkLibC();
@@ -184,6 +233,13 @@ pub fn build(b: *std.Build) !void {
     for (facilio_includes) |dep_path| {
         exe.addIncludePath(facilio_dep.path(dep_path));
     }
+    // zig's libC doesn't ship `sys/sdt.h`, the Nix shell points us to it.
+    // Without it the USDT probes compile to nothing.
+    if (b.graph.env_map.get("UWU_SDT_INCLUDE")) |sdt_include| {
+        if (sdt_include.len > 0) {
+            exe.addIncludePath(.{ .cwd_relative = sdt_include });
+        }
+    }
 
     for (facilio_examples) |example_path_in_dep| {
         var iter = std.mem.splitSequence(u8, example_path_in_dep, "/");
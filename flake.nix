@@ -38,6 +38,13 @@
           pkgs.wayland
         ]
         else [];
+
+      # bpftrace attaches to the USDT probes of the server, which need the
+      # `sys/sdt.h` header of libsystemtap to be compiled in.
+      tracingPkgs =
+        if pkgs.stdenv.isLinux
+        then [pkgs.bpftrace pkgs.libsystemtap]
+        else [];
     in {
       default = pkgs.mkShell {
         packages =
@@ -52,11 +59,15 @@
             pkgs.process-compose
             pkgs.clang-tools # For clang-format and others...
           ]
-          ++ raylibPkgs;
+          ++ raylibPkgs
+          ++ tracingPkgs;
 
         shellHook = ''
           UWU_LIB_PATH=${pkgs.lib.makeLibraryPath raylibPkgs}
         '';
+
+        # build.zig adds it to the include paths of the server.
+        UWU_SDT_INCLUDE = pkgs.lib.optionalString pkgs.stdenv.isLinux "${pkgs.libsystemtap}/include";
       };
     });
   };
@@ -0,0 +1,503 @@
+/**
+Microbenchmarks for the data structures of lib.c and hashmap.h.
+
+Every benchmark runs once to warm up and then `-runs` more times, each run
+measures the same amount of operations over inputs generated from a fixed seed.
+The output is a tab separated table on stdout with the median, min and max
+nanoseconds per operation and the allocations per operation, so the results of
+two builds can be compared with any diff or spreadsheet tool:
+
+    zig build bench -Doptimize=ReleaseFast -- -runs 9 > before.tsv
+
+Progress is printed on stderr.
+*/
+#include "hashmap.h"
+#include "lib.c"
+
+#include "fio_cli.h"
+
+/* *****************************************************************************
+Constants
+***************************************************************************** */
+
+// The biggest size any benchmark uses.
+#define BENCH_MAX_SIZE 100000
+// Operations measured by the benchmarks whose size is not an operation count.
+const size_t BENCH_OPS = 100000;
+// Lookups and removals done by the user list benchmarks, they're O(n) each.
+const size_t BENCH_LIST_OPS = 1000;
+// Entries visited by the iteration benchmarks on every run.
+const size_t BENCH_VISITS = 1000000;
+#define BENCH_MESSAGE_SIZE 32
+
+static const size_t LIST_SIZES[] = {10, 100, 1000, 10000, 100000, 0};
+static const size_t HISTORY_SIZES[] = {8, 100, 255, 0};
+static const size_t STRING_SIZES[] = {8, 32, 255, 0};
+static const size_t HASHMAP_SIZES[] = {10, 1000, 100000, 0};
+
+UWU_String SEPARATOR = {.data = "&/)", .length = 3};
+
+/* *****************************************************************************
+Inputs
+***************************************************************************** */
+
+static uint64_t rng_state = 0;
+
+// xorshift64*, the inputs only need to be the same on every run.
+uint64_t next_random() {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+// Usernames with different lengths, like the ones real users pick.
+static UWU_String names[BENCH_MAX_SIZE];
+// A random order of the indexes of `names`.
+static size_t shuffled[BENCH_MAX_SIZE];
+// The DM keys (`<first>&/)<second>`) of every pair of the first users.
+static UWU_String pair_keys[BENCH_MAX_SIZE];
+static char message[BENCH_MESSAGE_SIZE];
+// Two copies of the same text on different buffers.
+static char text_a[255];
+static char text_b[255];
+
+void init_inputs() {
+  rng_state = 0x5EED;
+
+  for (size_t i = 0; i < BENCH_MAX_SIZE; i++) {
+    char buffer[64];
+    int length = snprintf(buffer, sizeof(buffer), "%.*s%zu",
+                          (int)(next_random() % 12 + 1), "userfromchat", i);
+    UWU_String name = {.data = buffer, .length = length};
+
+    UWU_Err err = NO_ERROR;
+    names[i] = UWU_String_copy(&name, err);
+    if (err != NO_ERROR) {
+      UWU_PANIC("Fatal: Failed to allocate the usernames!");
+      return;
+    }
+    shuffled[i] = i;
+  }
+
+  for (size_t i = BENCH_MAX_SIZE - 1; i > 0; i--) {
+    size_t j = next_random() % (i + 1);
+    size_t tmp = shuffled[i];
+    shuffled[i] = shuffled[j];
+    shuffled[j] = tmp;
+  }
+
+  // Pairs are generated the same way the server does when a user connects.
+  size_t count = 0;
+  for (size_t other = 1; count < BENCH_MAX_SIZE; other++) {
+    for (size_t first = 0; first < other && count < BENCH_MAX_SIZE; first++) {
+      UWU_String *a = &names[first];
+      UWU_String *b = &names[other];
+      if (!UWU_String_firstGoesFirst(a, b)) {
+        a = &names[other];
+        b = &names[first];
+      }
+
+      UWU_String tmp = UWU_String_combineWithOther(a, &SEPARATOR);
+      pair_keys[count] = UWU_String_combineWithOther(&tmp, b);
+      UWU_String_freeWithMalloc(&tmp);
+      count++;
+    }
+  }
+
+  for (size_t i = 0; i < sizeof(text_a); i++) {
+    text_a[i] = 'a' + next_random() % 26;
+    text_b[i] = text_a[i];
+  }
+  memset(message, 'm', sizeof(message));
+}
+
+void deinit_inputs() {
+  for (size_t i = 0; i < BENCH_MAX_SIZE; i++) {
+    UWU_String_freeWithMalloc(&names[i]);
+    UWU_String_freeWithMalloc(&pair_keys[i]);
+  }
+}
+
+// Keeps the compiler from optimizing away the results of the benchmarks.
+static volatile size_t sink = 0;
+
+/* *****************************************************************************
+User list
+***************************************************************************** */
+
+static UWU_UserList bench_list = {};
+// The names `run_list_remove` removes, picked by `setup_full_list` so the
+// timed loop only removes.
+static size_t victims[BENCH_MAX_SIZE];
+static size_t victims_count = 0;
+
+void insert_users(size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    UWU_Err err = NO_ERROR;
+    UWU_User user = {.username = names[i], .status = ACTIVE};
+    struct UWU_UserListNode node = UWU_UserListNode_newWithValue(user);
+    UWU_UserList_insertEnd(&bench_list, &node, err);
+    if (err != NO_ERROR) {
+      UWU_PANIC("Fatal: Failed to insert a user!");
+      return;
+    }
+  }
+}
+
+void setup_empty_list(size_t size) {
+  UWU_Err err = NO_ERROR;
+  bench_list = UWU_UserList_init(err);
+  if (err != NO_ERROR) {
+    UWU_PANIC("Fatal: Failed to create the user list!");
+  }
+}
+
+void setup_full_list(size_t size) {
+  setup_empty_list(size);
+  insert_users(size);
+
+  // Only the first `size` names are on the list.
+  size_t ops = size < BENCH_LIST_OPS ? size : BENCH_LIST_OPS;
+  victims_count = 0;
+  for (size_t i = 0; victims_count < ops; i++) {
+    if (shuffled[i] < size) {
+      victims[victims_count] = shuffled[i];
+      victims_count++;
+    }
+  }
+}
+
+void teardown_list(size_t size) { UWU_UserList_deinit(&bench_list); }
+
+size_t run_list_insert(size_t size) {
+  insert_users(size);
+  return size;
+}
+
+size_t run_list_find(size_t size) {
+  for (size_t i = 0; i < BENCH_LIST_OPS; i++) {
+    UWU_User *user =
+        UWU_UserList_findByName(&bench_list, &names[shuffled[i] % size]);
+    sink += user != NULL;
+  }
+  return BENCH_LIST_OPS;
+}
+
+size_t run_list_remove(size_t size) {
+  for (size_t i = 0; i < victims_count; i++) {
+    UWU_UserList_removeByUsernameIfExists(&bench_list, &names[victims[i]]);
+  }
+  return victims_count;
+}
+
+/* *****************************************************************************
+Chat history
+***************************************************************************** */
+
+static UWU_ChatHistory bench_history = {};
+
+void append_entries(size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    UWU_ChatEntry entry = {
+        .content = {.data = message, .length = sizeof(message)},
+        .origin_username = names[i % BENCH_LIST_OPS],
+    };
+    UWU_ChatHistory_addMessage(&bench_history, &entry);
+  }
+}
+
+void setup_empty_history(size_t size) {
+  UWU_Err err = NO_ERROR;
+  UWU_String name = {.data = "~", .length = 1};
+  UWU_String channel_name = UWU_String_copy(&name, err);
+  if (err != NO_ERROR) {
+    UWU_PANIC("Fatal: Failed to copy the channel name!");
+    return;
+  }
+
+  bench_history = UWU_ChatHistory_init(size, channel_name, err);
+  if (err != NO_ERROR) {
+    UWU_PANIC("Fatal: Failed to create the chat history!");
+  }
+}
+
+// A history that already wrapped around a few times.
+void setup_full_history(size_t size) {
+  setup_empty_history(size);
+  append_entries(size * 3 + size / 2);
+}
+
+void teardown_history(size_t size) { UWU_ChatHistory_deinit(&bench_history); }
+
+size_t run_history_append(size_t size) {
+  append_entries(BENCH_OPS);
+  return BENCH_OPS;
+}
+
+size_t run_history_iterate(size_t size) {
+  size_t visited = 0;
+  while (visited < BENCH_VISITS) {
+    UWU_ChatHistory_Iterator iter = UWU_ChatHistory_iter(&bench_history);
+    for (size_t i = iter.start; i < iter.end; i++) {
+      UWU_ChatEntry entry =
+          UWU_ChatHistory_get(&bench_history, i % bench_history.capacity);
+      sink += entry.content.length + entry.origin_username.length;
+    }
+    visited += iter.end - iter.start;
+  }
+  return visited;
+}
+
+/* *****************************************************************************
+Strings
+***************************************************************************** */
+
+void setup_nothing(size_t size) {}
+
+void teardown_nothing(size_t size) {}
+
+size_t run_string_equal(size_t size) {
+  UWU_String a = {.data = text_a, .length = size};
+  UWU_String b = {.data = text_b, .length = size};
+  for (size_t i = 0; i < BENCH_OPS * 10; i++) {
+    sink += UWU_String_equal(&a, &b);
+  }
+  return BENCH_OPS * 10;
+}
+
+// Combines two halves of `size` the same way the DM keys are made.
+size_t run_string_combine(size_t size) {
+  UWU_String a = {.data = text_a, .length = size / 2};
+  UWU_String b = {.data = text_b, .length = size - size / 2};
+  for (size_t i = 0; i < BENCH_OPS; i++) {
+    UWU_String tmp = UWU_String_combineWithOther(&a, &SEPARATOR);
+    UWU_String combined = UWU_String_combineWithOther(&tmp, &b);
+    sink += combined.length;
+    UWU_String_freeWithMalloc(&tmp);
+    UWU_String_freeWithMalloc(&combined);
+  }
+  return BENCH_OPS;
+}
+
+size_t run_string_copy(size_t size) {
+  UWU_String a = {.data = text_a, .length = size};
+  for (size_t i = 0; i < BENCH_OPS; i++) {
+    UWU_Err err = NO_ERROR;
+    UWU_String copy = UWU_String_copy(&a, err);
+    sink += copy.length;
+    UWU_String_freeWithMalloc(&copy);
+  }
+  return BENCH_OPS;
+}
+
+/* *****************************************************************************
+Hashmap
+***************************************************************************** */
+
+static struct hashmap_s bench_map = {};
+
+void put_pairs(size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    UWU_String *key = &pair_keys[i];
+    if (0 != hashmap_put(&bench_map, key->data, key->length, key)) {
+      UWU_PANIC("Fatal: Failed to put a key on the hashmap!");
+      return;
+    }
+  }
+}
+
+// Starts small like the `chats` map of the server so puts include rehashes.
+void setup_empty_map(size_t size) {
+  if (0 != hashmap_create(8, &bench_map)) {
+    UWU_PANIC("Fatal: Failed to create the hashmap!");
+  }
+}
+
+void setup_full_map(size_t size) {
+  setup_empty_map(size);
+  put_pairs(size);
+}
+
+void teardown_map(size_t size) { hashmap_destroy(&bench_map); }
+
+size_t run_map_put(size_t size) {
+  put_pairs(size);
+  return size;
+}
+
+size_t run_map_get(size_t size) {
+  for (size_t i = 0; i < BENCH_OPS; i++) {
+    UWU_String *key = &pair_keys[shuffled[i] % size];
+    sink += hashmap_get(&bench_map, key->data, key->length) != NULL;
+  }
+  return BENCH_OPS;
+}
+
+int count_pair(void *const context, struct hashmap_element_s *const e) {
+  size_t *visited = context;
+  *visited += 1;
+  sink += e->key_len;
+  return 0;
+}
+
+size_t run_map_iterate_pairs(size_t size) {
+  size_t visited = 0;
+  while (visited < BENCH_VISITS) {
+    hashmap_iterate_pairs(&bench_map, count_pair, &visited);
+  }
+  return visited;
+}
+
+/* *****************************************************************************
+Harness
+***************************************************************************** */
+
+typedef struct {
+  const char *name;
+  // Zero terminated list of the sizes to run the benchmark with.
+  const size_t *sizes;
+  // Prepares the inputs, not measured.
+  void (*setup)(size_t size);
+  // The measured part, returns the amount of operations it did.
+  size_t (*run)(size_t size);
+  // Frees what `setup` and `run` created, not measured.
+  void (*teardown)(size_t size);
+} UWU_Bench;
+
+static const UWU_Bench BENCHES[] = {
+    {"userlist_insert", LIST_SIZES, setup_empty_list, run_list_insert,
+     teardown_list},
+    {"userlist_find", LIST_SIZES, setup_full_list, run_list_find,
+     teardown_list},
+    {"userlist_remove", LIST_SIZES, setup_full_list, run_list_remove,
+     teardown_list},
+    {"history_append", HISTORY_SIZES, setup_empty_history, run_history_append,
+     teardown_history},
+    {"history_iterate", HISTORY_SIZES, setup_full_history, run_history_iterate,
+     teardown_history},
+    {"string_equal", STRING_SIZES, setup_nothing, run_string_equal,
+     teardown_nothing},
+    {"string_combine", STRING_SIZES, setup_nothing, run_string_combine,
+     teardown_nothing},
+    {"string_copy", STRING_SIZES, setup_nothing, run_string_copy,
+     teardown_nothing},
+    {"hashmap_put", HASHMAP_SIZES, setup_empty_map, run_map_put,
+     teardown_map},
+    {"hashmap_get", HASHMAP_SIZES, setup_full_map, run_map_get, teardown_map},
+    {"hashmap_iterate_pairs", HASHMAP_SIZES, setup_full_map,
+     run_map_iterate_pairs, teardown_map},
+};
+
+typedef struct {
+  size_t ops;
+  double ns_per_op;
+  double allocs_per_op;
+} UWU_BenchRun;
+
+int compare_ns_per_op(const void *a, const void *b) {
+  double left = ((const UWU_BenchRun *)a)->ns_per_op;
+  double right = ((const UWU_BenchRun *)b)->ns_per_op;
+  return (left > right) - (left < right);
+}
+
+// Returns the amount of allocations done so far by every subsystem.
+size_t count_allocations() {
+  UWU_AllocTotals totals[UWU_ALLOC_SUBSYSTEMS_COUNT];
+  UWU_Alloc_totals(totals);
+
+  size_t allocations = 0;
+  for (size_t i = 0; i < UWU_ALLOC_SUBSYSTEMS_COUNT; i++) {
+    allocations += totals[i].allocations;
+  }
+  return allocations;
+}
+
+UWU_BenchRun measure(const UWU_Bench *bench, size_t size) {
+  bench->setup(size);
+
+  size_t allocations = count_allocations();
+  uint64_t start = UWU_monotonicNs();
+
+  size_t ops = bench->run(size);
+
+  uint64_t elapsed = UWU_monotonicNs() - start;
+  allocations = count_allocations() - allocations;
+
+  bench->teardown(size);
+
+  ops = ops > 0 ? ops : 1;
+  UWU_BenchRun run = {
+      .ops = ops,
+      .ns_per_op = (double)elapsed / ops,
+      .allocs_per_op = (double)allocations / ops,
+  };
+  return run;
+}
+
+// Runs `bench` with `size` and prints a line with the results.
+void run_bench(const UWU_Bench *bench, size_t size, size_t runs) {
+  UWU_BenchRun results[runs];
+
+  measure(bench, size);
+  for (size_t i = 0; i < runs; i++) {
+    results[i] = measure(bench, size);
+  }
+  qsort(results, runs, sizeof(UWU_BenchRun), compare_ns_per_op);
+
+  printf("%s\t%zu\t%zu\t%zu\t%.2f\t%.2f\t%.2f\t%.3f\n", bench->name, size, runs,
+         results[0].ops, results[runs / 2].ns_per_op, results[0].ns_per_op,
+         results[runs - 1].ns_per_op, results[runs / 2].allocs_per_op);
+  fflush(stdout);
+}
+
+int main(int argc, char const *argv[]) {
+  fio_cli_start(
+      argc, argv, 0, 0,
+      "Runs the microbenchmarks of the UwuChat data structures, printing a "
+      "tab separated table.",
+      FIO_CLI_STRING("-filter -f only run the benchmarks whose name "
+                     "contains this text."),
+      FIO_CLI_INT("-runs -r measured runs of every benchmark, the median is "
+                  "reported. default: 5"),
+      FIO_CLI_INT("-max-size -m skip sizes bigger than this one. default: "
+                  "100000"));
+
+  /* CLI set functions (unlike fio_cli_start) ignores aliases */
+  fio_cli_set_default("-runs", "5");
+  fio_cli_set_default("-r", "5");
+
+  fio_cli_set_default("-max-size", "100000");
+  fio_cli_set_default("-m", "100000");
+
+  int runs = fio_cli_get_i("-runs");
+  int max_size = fio_cli_get_i("-max-size");
+  const char *filter = fio_cli_get("-filter");
+  if (runs <= 0 || max_size <= 0) {
+    fprintf(stderr, "Error: Runs and max size must be positive!\n");
+    return 1;
+  }
+
+  init_inputs();
+
+  printf("benchmark\tsize\truns\tops\tns_per_op\tmin_ns_per_op\t"
+         "max_ns_per_op\tallocs_per_op\n");
+  for (size_t i = 0; i < sizeof(BENCHES) / sizeof(BENCHES[0]); i++) {
+    const UWU_Bench *bench = &BENCHES[i];
+    if (filter && NULL == strstr(bench->name, filter)) {
+      continue;
+    }
+
+    for (const size_t *size = bench->sizes; *size != 0; size++) {
+      if (*size > (size_t)max_size) {
+        continue;
+      }
+      fprintf(stderr, "Info: Running %s/%zu...\n", bench->name, *size);
+      run_bench(bench, *size, runs);
+    }
+  }
+
+  deinit_inputs();
+  fio_cli_end();
+  return 0;
+}
@@ -118,7 +118,7 @@ fio_str_info_s UWU_TextInput_toFio(UWU_Err err) {
   printf("Total length: %d\n", length);
   printf("username lenght: %d\n", username_length);
   printf("message leng: %d\n", message_length);
-  char *data = malloc(length);
+  char *data = UWU_malloc(UWU_ALLOC_RESPONSES, length);
 
   if (data == NULL) {
     err = MALLOC_FAILED;
@@ -172,7 +172,7 @@ void UWU_Update() {
       UWU_PANIC("Unable to allocate fio string before sending message");
     }
     send_message(UWU_ws_client, &message);
-    free(message.data);
+    UWU_free(message.data);
     UWU_TextInput_clear();
   } else if (IsKeyPressed(KEY_BACKSPACE)) {
     UWU_TextInput_remove_last();
@@ -187,7 +187,7 @@ void BusyBtnHandler(Clay_ElementId elementId, Clay_PointerData pointerInfo,
   if (pointerInfo.state == CLAY_POINTER_DATA_PRESSED_THIS_FRAME) {
     size_t username_length = UWU_current_user.username.length;
     size_t length = 3 + username_length;
-    char *data = malloc(length);
+    char *data = UWU_malloc(UWU_ALLOC_RESPONSES, length);
 
     data[0] = CHANGE_STATUS;
     data[1] = username_length;
@@ -200,7 +200,7 @@ void BusyBtnHandler(Clay_ElementId elementId, Clay_PointerData pointerInfo,
 
     fio_str_info_s msg = {.data = data, .len = length};
     int err = websocket_write(UWU_ws_client, msg, 0);
-    free(data);
+    UWU_free(data);
   }
 }
 
@@ -210,7 +210,7 @@ void ActiveBtnHandler(Clay_ElementId elementId, Clay_PointerData pointerInfo,
   if (pointerInfo.state == CLAY_POINTER_DATA_PRESSED_THIS_FRAME) {
     size_t username_length = UWU_current_user.username.length;
     size_t length = 3 + username_length;
-    char *data = malloc(length);
+    char *data = UWU_malloc(UWU_ALLOC_RESPONSES, length);
 
     data[0] = CHANGE_STATUS;
     data[1] = username_length;
@@ -223,7 +223,7 @@ void ActiveBtnHandler(Clay_ElementId elementId, Clay_PointerData pointerInfo,
 
     fio_str_info_s msg = {.data = data, .len = length};
     int err = websocket_write(UWU_ws_client, msg, 0);
-    free(data);
+    UWU_free(data);
   }
 }
 
@@ -235,11 +235,11 @@ void ChangeChatHandler(Clay_ElementId elementId, Clay_PointerData pointerInfo,
     UWU_User *userValue = (UWU_User *)userPointer;
     char *tempUser = UWU_String_toCStr(&userValue->username);
     printf("Change Chat to %s!\n", tempUser);
-    free(tempUser);
+    UWU_free(tempUser);
 
     UWU_User *user = (UWU_User *)userPointer;
     size_t length = 2 + user->username.length;
-    char *data = malloc(length);
+    char *data = UWU_malloc(UWU_ALLOC_RESPONSES, length);
     if (data == NULL) {
       UWU_PANIC("COULD NOT INITIALIZE USER NAME ARRAY");
     }
@@ -252,14 +252,83 @@ void ChangeChatHandler(Clay_ElementId elementId, Clay_PointerData pointerInfo,
 
     fio_str_info_s msg = {.data = data, .len = length};
     websocket_write(UWU_ws_client, msg, 0);
-    free(data);
+    UWU_free(data);
   }
 }
 
+// Asks the server for the status changes of the users on the contacts list.
+// Only the first `MAX_WATCHED_USERS` are watched, the server already sends
+// every user joining and leaving.
+void send_watch_list(ws_s *ws) {
+  // | type | users count | username length | username | ...
+  char data[2 + (1 + 255) * MAX_WATCHED_USERS]; // 255 is the max username!
+  size_t data_length = 2;
+  size_t watched_count = 0;
+
+  for (struct UWU_UserListNode *current = active_usernames.start;
+       current != NULL && watched_count < MAX_WATCHED_USERS;
+       current = current->next) {
+    if (current->is_sentinel) {
+      continue;
+    }
+
+    size_t username_length = current->data.username.length;
+    data[data_length] = username_length;
+    memcpy(&data[data_length + 1], current->data.username.data,
+           username_length);
+    data_length += 1 + username_length;
+    watched_count++;
+  }
+
+  data[0] = WATCH_USERS;
+  data[1] = watched_count;
+
+  fio_str_info_s msg = {.data = data, .len = data_length};
+  send_message(ws, &msg);
+}
+
+// Updates the status of a user from a presence message, adding or removing it
+// from the contacts list when needed.
+// Returns TRUE when the contacts list changed.
+UWU_Bool update_user_status(UWU_String *username, UWU_ConnStatus status) {
+  if (UWU_String_equal(&UWU_current_user.username, username)) {
+    UWU_current_user.status = status;
+    return FALSE;
+  }
+
+  if (status == DISCONNETED) {
+    size_t previous_length = active_usernames.length;
+    UWU_UserList_removeByUsernameIfExists(&active_usernames, username);
+    return previous_length != active_usernames.length;
+  }
+
+  UWU_User *user = UWU_UserList_findByName(&active_usernames, username);
+  if (NULL != user) {
+    user->status = status;
+    return FALSE;
+  }
+
+  UWU_Err err = NO_ERROR;
+  UWU_User new_user = {.username = *username, .status = status};
+  struct UWU_UserListNode node = UWU_UserListNode_newWithValue(new_user);
+
+  UWU_UserList_insertEnd(&active_usernames, &node, err);
+  if (err != NO_ERROR) {
+    UWU_PANIC("Fatal: Couldn't add username to active usernames!");
+    return FALSE;
+  }
+  return TRUE;
+}
+
 // Callback when WebSocket is opened
 void on_open(ws_s *ws) {
   printf("Connected to WebSocket server!\n");
   UWU_ws_client = ws;
+
+  // The contacts list starts with everyone that's already connected.
+  char data[] = {LIST_USERS};
+  fio_str_info_s msg = {.data = data, .len = 1};
+  send_message(ws, &msg);
 }
 
 // Callback when a message is received
@@ -270,48 +339,37 @@ void on_message(ws_s *ws, fio_str_info_s msg, uint8_t is_text) {
     fprintf(stderr, "Error: An error has ocurred! %d", msg.data[1]);
   } break;
   case LISTED_USERS: {
+    // | type | users count | username length | username | status | ...
+    size_t users_count = (uint8_t)msg.data[1];
+    size_t offset = 2;
+    for (size_t i = 0; i < users_count && offset < msg.len; i++) {
+      size_t username_length = (uint8_t)msg.data[offset];
+      if (offset + 2 + username_length > msg.len) {
+        fprintf(stderr, "Error: Invalid users list!\n");
+        break;
+      }
 
-  } break;
-  case GOT_USER: {
+      UWU_String username = {.data = &msg.data[offset + 1],
+                             .length = username_length};
+      update_user_status(&username, msg.data[offset + 1 + username_length]);
+      offset += 2 + username_length;
+    }
 
+    send_watch_list(ws);
   } break;
-  case REGISTERED_USER: {
+  case GOT_USER: {
 
   } break;
+  case REGISTERED_USER:
   case CHANGED_STATUS: {
     size_t username_length = msg.data[1];
     UWU_ConnStatus req_status = msg.data[2 + username_length];
     UWU_String req_username = {.data = &msg.data[2], .length = username_length};
 
-    if (UWU_String_equal(&UWU_current_user.username, &req_username)) {
-      UWU_current_user.status = req_status;
-    } else {
-      UWU_Bool found_it = FALSE;
-      for (struct UWU_UserListNode *current = active_usernames.start;
-           current != NULL; current = current->next) {
-        if (current->is_sentinel) {
-          continue;
-        }
-
-        if (UWU_String_equal(&current->data.username, &req_username)) {
-          found_it = TRUE;
-          current->data.status = req_status;
-        }
-      }
-
-      if (!found_it) {
-        UWU_Err err = NO_ERROR;
-        UWU_User user = {.username = req_username, .status = req_status};
-        struct UWU_UserListNode node = UWU_UserListNode_newWithValue(user);
-
-        UWU_UserList_insertEnd(&active_usernames, &node, err);
-        if (err != NO_ERROR) {
-          UWU_PANIC("Fatal: Couldn't add username to active usernames!");
-          return;
-        }
-      }
+    // Joining and leaving users change who's on the watch list.
+    if (update_user_status(&req_username, req_status)) {
+      send_watch_list(ws);
     }
-
   } break;
   case GOT_MESSAGE: {
 
@@ -627,7 +685,8 @@ void initialize_client_state(UWU_Err err, char *username) {
   // Current chat initalization
   UWU_current_chat = NULL;
 
-  UWU_TextInput.data = (char *)malloc(MAX_CHARACTERS_INPUT + 1);
+  UWU_TextInput.data =
+      UWU_malloc(UWU_ALLOC_STRINGS, MAX_CHARACTERS_INPUT + 1);
   if (UWU_TextInput.data == NULL) {
     err = MALLOC_FAILED;
     return;
@@ -637,7 +696,7 @@ void initialize_client_state(UWU_Err err, char *username) {
 
   // Create current user
   size_t name_length = strlen(username);
-  char *username_data = malloc(name_length);
+  char *username_data = UWU_malloc(UWU_ALLOC_STRINGS, name_length);
   if (NULL == username_data) {
     err = MALLOC_FAILED;
     return;
@@ -754,7 +813,7 @@ int main(int argc, char *argv[]) {
   // Clay Initialization
   uint64_t totalMemorySize = Clay_MinMemorySize();
   Clay_Arena clayMemory = Clay_CreateArenaWithCapacityAndMemory(
-      totalMemorySize, malloc(totalMemorySize));
+      totalMemorySize, UWU_malloc(UWU_ALLOC_ARENAS, totalMemorySize));
   Clay_Initialize(
       clayMemory,
       (Clay_Dimensions){(float)GetScreenWidth(), (float)GetScreenHeight()},
@@ -778,7 +837,7 @@ int main(int argc, char *argv[]) {
       Clay_SetMaxElementCount(8192);
       totalMemorySize = Clay_MinMemorySize();
       clayMemory = Clay_CreateArenaWithCapacityAndMemory(
-          totalMemorySize, malloc(totalMemorySize));
+          totalMemorySize, UWU_malloc(UWU_ALLOC_ARENAS, totalMemorySize));
       Clay_Initialize(
           clayMemory,
           (Clay_Dimensions){(float)GetScreenWidth(), (float)GetScreenHeight()},
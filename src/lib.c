@@ -7,6 +7,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#if defined(__has_include) && __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define UWU_ALLOC_HAS_BACKTRACE 1
+#endif
 
 /* *****************************************************************************
 Welcum
@@ -57,6 +61,467 @@ void UWU_PANIC(const char *format, ...) {
   exit(1);
 }
 
+/* *****************************************************************************
+Allocations
+***************************************************************************** */
+
+// All the memory of the program is allocated through `UWU_malloc` and friends,
+// so we always know how much memory each part of the program holds and which
+// lines of code allocate the most.
+//
+// Memory obtained from `UWU_malloc` MUST be freed with `UWU_free` and vice
+// versa, never mix them with the `malloc` from libC!
+
+// The parts of the program memory is allocated for.
+typedef enum {
+  UWU_ALLOC_ARENAS,
+  UWU_ALLOC_STRINGS,
+  UWU_ALLOC_USERS,
+  UWU_ALLOC_HISTORIES,
+  UWU_ALLOC_SESSIONS,
+  UWU_ALLOC_RESPONSES,
+  UWU_ALLOC_DIAGNOSTICS,
+  // Not a subsystem! The amount of subsystems.
+  UWU_ALLOC_SUBSYSTEMS_COUNT,
+} UWU_AllocSubsystem;
+
+static const char *UWU_ALLOC_SUBSYSTEM_NAMES[] = {
+    [UWU_ALLOC_ARENAS] = "arenas",
+    [UWU_ALLOC_STRINGS] = "strings",
+    [UWU_ALLOC_USERS] = "users",
+    [UWU_ALLOC_HISTORIES] = "histories",
+    [UWU_ALLOC_SESSIONS] = "sessions",
+    [UWU_ALLOC_RESPONSES] = "responses",
+    [UWU_ALLOC_DIAGNOSTICS] = "diagnostics",
+};
+
+// A line of code that allocates memory.
+typedef struct {
+  const char *file;
+  int line;
+  UWU_AllocSubsystem subsystem;
+} UWU_AllocSite;
+
+// Keeps count of the memory allocated by a single site on a single thread.
+//
+// Every thread only writes its own counters, so allocating doesn't need any
+// atomic operation. Memory freed by another thread is subtracted from that
+// thread's counters, so a single thread can go below zero but the sum of all
+// threads is always right.
+typedef struct {
+  // The amount of allocations ever made.
+  size_t allocations;
+  // The amount of bytes ever allocated.
+  size_t total_bytes;
+  // The amount of allocations that haven't been freed.
+  size_t live_allocations;
+  // The amount of bytes that haven't been freed.
+  size_t live_bytes;
+} UWU_AllocCounters;
+
+// The max amount of different sites, the allocations of any site after it are
+// accounted to the first one.
+#define UWU_ALLOC_MAX_SITES 512
+// The slots of the cache each thread has to find the index of a site.
+// It MUST be a power of two.
+#define UWU_ALLOC_SITE_CACHE 1024
+
+// The allocation counters of a thread.
+typedef struct UWU_AllocThread {
+  // Indexed by the index of the site inside `UWU_alloc_sites`.
+  UWU_AllocCounters counters[UWU_ALLOC_MAX_SITES];
+  // Maps a file, line and subsystem to the index of its site.
+  struct {
+    const char *file;
+    int line;
+    UWU_AllocSubsystem subsystem;
+    size_t site;
+  } cache[UWU_ALLOC_SITE_CACHE];
+  // The amount of allocations made, used to decide which ones to sample.
+  size_t allocations;
+  // The counters of the next thread.
+  struct UWU_AllocThread *next;
+} UWU_AllocThread;
+
+// Every allocation starts with this header, right before the memory returned
+// to the caller. It keeps the 16 bytes alignment malloc gives us.
+typedef struct {
+  size_t site;
+  size_t size;
+} UWU_AllocHeader;
+
+// All the sites that allocated at least once, the first one also holds the
+// sites that didn't fit.
+// Only add new items to it while holding `UWU_alloc_sites_lock`!
+UWU_AllocSite UWU_alloc_sites[UWU_ALLOC_MAX_SITES] = {
+    {.file = "(other sites)", .line = 0, .subsystem = UWU_ALLOC_DIAGNOSTICS}};
+size_t UWU_alloc_sites_count = 1;
+fio_lock_i UWU_alloc_sites_lock = FIO_LOCK_INIT;
+
+// The counters of the current thread, created on first use.
+static __thread UWU_AllocThread *UWU_alloc_thread = NULL;
+// The counters of every thread that ever allocated or freed.
+// Only add new items to it while holding `UWU_alloc_sites_lock`!
+UWU_AllocThread *UWU_alloc_threads = NULL;
+
+// Sample the stack of one every `UWU_alloc_sample_every` allocations.
+// 0 disables sampling.
+size_t UWU_alloc_sample_every = 0;
+
+// The max amount of frames saved for every sampled stack.
+#define UWU_ALLOC_SAMPLE_FRAMES 16
+// The amount of sampled stacks remembered, older ones are overridden.
+#define UWU_ALLOC_SAMPLES 1024
+
+// The stack of a sampled allocation.
+typedef struct {
+  size_t site;
+  size_t size;
+  void *frames[UWU_ALLOC_SAMPLE_FRAMES];
+  int frames_count;
+} UWU_AllocSample;
+
+UWU_AllocSample UWU_alloc_samples[UWU_ALLOC_SAMPLES];
+// The amount of samples ever taken, use % to get the index of the next one.
+size_t UWU_alloc_samples_count = 0;
+
+#define UWU_malloc(subsystem, size)                                            \
+  UWU_Alloc_malloc(__FILE__, __LINE__, (subsystem), (size))
+#define UWU_calloc(subsystem, count, size)                                     \
+  UWU_Alloc_calloc(__FILE__, __LINE__, (subsystem), (count), (size))
+#define UWU_realloc(subsystem, ptr, size)                                      \
+  UWU_Alloc_realloc(__FILE__, __LINE__, (subsystem), (ptr), (size))
+#define UWU_free(ptr) UWU_Alloc_free(ptr)
+
+// Returns the counters of the current thread.
+static UWU_AllocThread *UWU_Alloc_thread() {
+  if (NULL != UWU_alloc_thread) {
+    return UWU_alloc_thread;
+  }
+
+  // Not allocated with `UWU_calloc`, it would count itself.
+  UWU_AllocThread *thread = calloc(1, sizeof(UWU_AllocThread));
+  if (NULL == thread) {
+    UWU_PANIC("Fatal: Failed to allocate the allocation counters of a thread!");
+    return NULL;
+  }
+
+  fio_lock(&UWU_alloc_sites_lock);
+  thread->next = UWU_alloc_threads;
+  UWU_alloc_threads = thread;
+  fio_unlock(&UWU_alloc_sites_lock);
+
+  UWU_alloc_thread = thread;
+  return thread;
+}
+
+// Returns the index of the site of `file` and `line`, registering it the first
+// time any thread sees it.
+static size_t UWU_Alloc_registerSite(const char *file, int line,
+                                     UWU_AllocSubsystem subsystem) {
+  fio_lock(&UWU_alloc_sites_lock);
+  size_t idx = 1;
+  for (; idx < UWU_alloc_sites_count; idx++) {
+    UWU_AllocSite *site = &UWU_alloc_sites[idx];
+    if (site->line == line && site->subsystem == subsystem &&
+        0 == strcmp(site->file, file)) {
+      break;
+    }
+  }
+
+  if (idx == UWU_alloc_sites_count) {
+    if (idx == UWU_ALLOC_MAX_SITES) {
+      idx = 0;
+    } else {
+      UWU_alloc_sites[idx] = (UWU_AllocSite){
+          .file = file, .line = line, .subsystem = subsystem};
+      __atomic_store_n(&UWU_alloc_sites_count, idx + 1, __ATOMIC_RELEASE);
+    }
+  }
+  fio_unlock(&UWU_alloc_sites_lock);
+
+  return idx;
+}
+
+// Returns the index of the site of `file` and `line`.
+// After the first time a thread sees it, it's only a lookup on its own cache.
+static inline size_t UWU_Alloc_site(UWU_AllocThread *thread, const char *file,
+                                    int line, UWU_AllocSubsystem subsystem) {
+  size_t slot = ((uintptr_t)file ^ ((size_t)line * 2654435761u)) &
+                (UWU_ALLOC_SITE_CACHE - 1);
+  for (size_t i = 0; i < UWU_ALLOC_SITE_CACHE; i++) {
+    size_t idx = (slot + i) & (UWU_ALLOC_SITE_CACHE - 1);
+    if (thread->cache[idx].file == file && thread->cache[idx].line == line &&
+        thread->cache[idx].subsystem == subsystem) {
+      return thread->cache[idx].site;
+    }
+
+    if (NULL == thread->cache[idx].file) {
+      size_t site = UWU_Alloc_registerSite(file, line, subsystem);
+      thread->cache[idx].file = file;
+      thread->cache[idx].line = line;
+      thread->cache[idx].subsystem = subsystem;
+      thread->cache[idx].site = site;
+      return site;
+    }
+  }
+
+  // The cache is full, there are way more lines than sites!
+  return UWU_Alloc_registerSite(file, line, subsystem);
+}
+
+// Adds the allocation to the counters of its site on the current thread.
+// Returns the index of the site.
+static size_t UWU_Alloc_track(const char *file, int line,
+                              UWU_AllocSubsystem subsystem, size_t size) {
+  UWU_AllocThread *thread = UWU_Alloc_thread();
+  size_t site = UWU_Alloc_site(thread, file, line, subsystem);
+
+  UWU_AllocCounters *counters = &thread->counters[site];
+  counters->allocations++;
+  counters->total_bytes += size;
+  counters->live_allocations++;
+  counters->live_bytes += size;
+
+#ifdef UWU_ALLOC_HAS_BACKTRACE
+  size_t sample_every = UWU_alloc_sample_every;
+  if (sample_every > 0 && thread->allocations++ % sample_every == 0) {
+    size_t idx = __atomic_fetch_add(&UWU_alloc_samples_count, 1,
+                                    __ATOMIC_RELAXED) %
+                 UWU_ALLOC_SAMPLES;
+    UWU_AllocSample *sample = &UWU_alloc_samples[idx];
+    sample->site = site;
+    sample->size = size;
+    sample->frames_count =
+        backtrace(sample->frames, UWU_ALLOC_SAMPLE_FRAMES);
+  }
+#endif
+
+  return site;
+}
+
+// Removes the allocation from the counters of its site on the current thread.
+static void UWU_Alloc_untrack(size_t site, size_t size) {
+  UWU_AllocCounters *counters = &UWU_Alloc_thread()->counters[site];
+  counters->live_allocations--;
+  counters->live_bytes -= size;
+}
+
+// Allocates `size` bytes on behalf of the line `line` of `file`.
+// Use `UWU_malloc` instead! Returns NULL if malloc fails.
+void *UWU_Alloc_malloc(const char *file, int line,
+                       UWU_AllocSubsystem subsystem, size_t size) {
+  UWU_AllocHeader *header = malloc(sizeof(UWU_AllocHeader) + size);
+  if (NULL == header) {
+    return NULL;
+  }
+
+  header->site = UWU_Alloc_track(file, line, subsystem, size);
+  header->size = size;
+
+  return header + 1;
+}
+
+// Allocates `count * size` zeroed bytes on behalf of the line `line` of
+// `file`. Use `UWU_calloc` instead! Returns NULL if calloc fails.
+void *UWU_Alloc_calloc(const char *file, int line,
+                       UWU_AllocSubsystem subsystem, size_t count,
+                       size_t size) {
+  if (size != 0 && count > (SIZE_MAX - sizeof(UWU_AllocHeader)) / size) {
+    return NULL;
+  }
+
+  UWU_AllocHeader *header = calloc(1, sizeof(UWU_AllocHeader) + count * size);
+  if (NULL == header) {
+    return NULL;
+  }
+
+  header->site = UWU_Alloc_track(file, line, subsystem, count * size);
+  header->size = count * size;
+
+  return header + 1;
+}
+
+// Frees memory obtained from `UWU_malloc`, `UWU_calloc` or `UWU_realloc`.
+// Just like `free` it does nothing with NULL.
+void UWU_Alloc_free(void *ptr) {
+  if (NULL == ptr) {
+    return;
+  }
+
+  UWU_AllocHeader *header = (UWU_AllocHeader *)ptr - 1;
+  UWU_Alloc_untrack(header->site, header->size);
+  free(header);
+}
+
+// Resizes memory obtained from `UWU_malloc` and friends, the memory is now
+// accounted to the line `line` of `file`. Use `UWU_realloc` instead!
+// Returns NULL if realloc fails, `ptr` is still valid in that case.
+void *UWU_Alloc_realloc(const char *file, int line,
+                        UWU_AllocSubsystem subsystem, void *ptr, size_t size) {
+  if (NULL == ptr) {
+    return UWU_Alloc_malloc(file, line, subsystem, size);
+  }
+
+  UWU_AllocHeader *old_header = (UWU_AllocHeader *)ptr - 1;
+  size_t old_site = old_header->site;
+  size_t old_size = old_header->size;
+
+  UWU_AllocHeader *header =
+      realloc(old_header, sizeof(UWU_AllocHeader) + size);
+  if (NULL == header) {
+    return NULL;
+  }
+
+  UWU_Alloc_untrack(old_site, old_size);
+  header->site = UWU_Alloc_track(file, line, subsystem, size);
+  header->size = size;
+
+  return header + 1;
+}
+
+// The memory held by a subsystem.
+typedef struct {
+  size_t live_bytes;
+  size_t live_allocations;
+  size_t allocations;
+} UWU_AllocTotals;
+
+// Adds up the counters of every thread per site.
+// `counters` must hold `UWU_ALLOC_MAX_SITES` items. Returns the amount of
+// sites.
+//
+// Threads keep allocating while we read, so the result may be slightly off
+// but it's never torn for a single counter.
+size_t UWU_Alloc_mergeSites(UWU_AllocCounters *counters) {
+  memset(counters, 0, sizeof(UWU_AllocCounters) * UWU_ALLOC_MAX_SITES);
+  size_t sites_count =
+      __atomic_load_n(&UWU_alloc_sites_count, __ATOMIC_ACQUIRE);
+
+  fio_lock(&UWU_alloc_sites_lock);
+  for (UWU_AllocThread *thread = UWU_alloc_threads; thread != NULL;
+       thread = thread->next) {
+    for (size_t i = 0; i < sites_count; i++) {
+      UWU_AllocCounters *current = &thread->counters[i];
+      counters[i].allocations += current->allocations;
+      counters[i].total_bytes += current->total_bytes;
+      counters[i].live_allocations += current->live_allocations;
+      counters[i].live_bytes += current->live_bytes;
+    }
+  }
+  fio_unlock(&UWU_alloc_sites_lock);
+
+  return sites_count;
+}
+
+// Adds up the counters of all sites per subsystem.
+// `totals` must hold `UWU_ALLOC_SUBSYSTEMS_COUNT` items.
+void UWU_Alloc_totals(UWU_AllocTotals *totals) {
+  memset(totals, 0, sizeof(UWU_AllocTotals) * UWU_ALLOC_SUBSYSTEMS_COUNT);
+
+  UWU_AllocCounters *counters =
+      malloc(sizeof(UWU_AllocCounters) * UWU_ALLOC_MAX_SITES);
+  if (NULL == counters) {
+    return;
+  }
+
+  size_t sites_count = UWU_Alloc_mergeSites(counters);
+  for (size_t i = 0; i < sites_count; i++) {
+    UWU_AllocTotals *total = &totals[UWU_alloc_sites[i].subsystem];
+    total->live_bytes += counters[i].live_bytes;
+    total->live_allocations += counters[i].live_allocations;
+    total->allocations += counters[i].allocations;
+  }
+
+  free(counters);
+}
+
+// The merged counters `UWU_Alloc_report` sorts the sites by.
+static UWU_AllocCounters *UWU_alloc_report_counters = NULL;
+
+static int UWU_AllocSite_compareLiveBytes(const void *a, const void *b) {
+  UWU_AllocCounters *site_a = &UWU_alloc_report_counters[*(size_t *)a];
+  UWU_AllocCounters *site_b = &UWU_alloc_report_counters[*(size_t *)b];
+
+  if (site_a->live_bytes == site_b->live_bytes) {
+    return site_a->allocations < site_b->allocations ? 1 : -1;
+  }
+  return site_a->live_bytes < site_b->live_bytes ? 1 : -1;
+}
+
+// Writes a report of the memory held per subsystem and the `top` call sites
+// holding the most memory. If sampling is enabled it also writes the sampled
+// stacks of those call sites.
+//
+// Only one report can be written at a time.
+void UWU_Alloc_report(FILE *out, size_t top) {
+  UWU_AllocTotals totals[UWU_ALLOC_SUBSYSTEMS_COUNT];
+  UWU_Alloc_totals(totals);
+
+  fprintf(out, "== Allocations per subsystem ==\n");
+  for (size_t i = 0; i < UWU_ALLOC_SUBSYSTEMS_COUNT; i++) {
+    fprintf(out, "%-12s live: %zu bytes in %zu allocations (total: %zu)\n",
+            UWU_ALLOC_SUBSYSTEM_NAMES[i], totals[i].live_bytes,
+            totals[i].live_allocations, totals[i].allocations);
+  }
+
+  UWU_AllocCounters *counters =
+      malloc(sizeof(UWU_AllocCounters) * UWU_ALLOC_MAX_SITES);
+  size_t *sites = malloc(sizeof(size_t) * UWU_ALLOC_MAX_SITES);
+  if (NULL == counters || NULL == sites) {
+    fprintf(out, "Can't allocate memory to sort the call sites!\n");
+    free(counters);
+    free(sites);
+    return;
+  }
+
+  size_t sites_count = UWU_Alloc_mergeSites(counters);
+  for (size_t i = 0; i < sites_count; i++) {
+    sites[i] = i;
+  }
+  UWU_alloc_report_counters = counters;
+  qsort(sites, sites_count, sizeof(size_t), UWU_AllocSite_compareLiveBytes);
+
+  fprintf(out, "== Top call sites ==\n");
+  for (size_t i = 0; i < sites_count && i < top; i++) {
+    UWU_AllocSite *site = &UWU_alloc_sites[sites[i]];
+    UWU_AllocCounters *site_counters = &counters[sites[i]];
+    fprintf(out,
+            "%s:%d (%s) live: %zu bytes in %zu allocations, total: %zu bytes "
+            "in %zu allocations\n",
+            site->file, site->line, UWU_ALLOC_SUBSYSTEM_NAMES[site->subsystem],
+            site_counters->live_bytes, site_counters->live_allocations,
+            site_counters->total_bytes, site_counters->allocations);
+
+#ifdef UWU_ALLOC_HAS_BACKTRACE
+    size_t samples_count = UWU_alloc_samples_count < UWU_ALLOC_SAMPLES
+                               ? UWU_alloc_samples_count
+                               : UWU_ALLOC_SAMPLES;
+    size_t printed = 0;
+    for (size_t j = 0; j < samples_count && printed < 3; j++) {
+      UWU_AllocSample *sample = &UWU_alloc_samples[j];
+      if (sample->site != sites[i]) {
+        continue;
+      }
+
+      fprintf(out, "  sampled stack (%zu bytes):\n", sample->size);
+      fflush(out);
+      char **symbols = backtrace_symbols(sample->frames, sample->frames_count);
+      // The first two frames are the allocator itself.
+      for (int k = 2; NULL != symbols && k < sample->frames_count; k++) {
+        fprintf(out, "    %s\n", symbols[k]);
+      }
+      free(symbols);
+      printed++;
+    }
+#endif
+  }
+
+  UWU_alloc_report_counters = NULL;
+  free(counters);
+  free(sites);
+}
+
 /* *****************************************************************************
 Enums
 ***************************************************************************** */
@@ -76,9 +541,20 @@ typedef enum {
   GET_USER,
   CHANGE_STATUS,
   SEND_MESSAGE,
+  // An optional byte after the username asks for an older page of the history,
+  // only available when the server keeps a cold storage.
   GET_MESSAGES,
+  // Replaces the set of users whose status changes (CHANGED_STATUS) this
+  // connection receives, by default it only watches its own user. Watching
+  // `~` means everyone. Users joining and leaving are always received.
+  // A list with more than `MAX_WATCHED_USERS` is refused with
+  // TOO_MANY_WATCHED_USERS.
+  WATCH_USERS,
 } UWU_ServerMessages;
 
+// The max quantity of users a single connection can watch at the same time.
+#define MAX_WATCHED_USERS 64
+
 // Represents all the "type codes" of messages the client receives from the
 // server.
 typedef enum {
@@ -100,8 +576,76 @@ typedef enum {
   EMPTY_MESSAGE,
   // You're trying to communicate with a disconnected user!
   USER_ALREADY_DISCONNECTED,
+  // You're not reading messages fast enough, the connection will be closed!
+  SLOW_CONSUMER,
+  // You're sending requests too fast, slow down!
+  RATE_LIMITED,
+  // Your watch list has more users than the server allows!
+  TOO_MANY_WATCHED_USERS,
+  // Another connection took your username first, the connection will be
+  // closed!
+  USERNAME_TAKEN,
 } UWU_Errors;
 
+/* *****************************************************************************
+Captures
+***************************************************************************** */
+
+// Capture files record the inbound WebSocket frames of a server so they can be
+// replayed later against another one.
+//
+// The file starts with `UWU_CAPTURE_MAGIC`, followed by records:
+//
+//   | type | connection id | microseconds since the previous record | ...
+//
+// OPEN records end with `| username length | username |`, FRAME records with
+// `| frame length | frame |` and CLOSE records have nothing else. All the
+// numbers except the type are LEB128 varints, so a record only adds a few bytes
+// on top of its frame. Connection ids start at 1.
+static const char UWU_CAPTURE_MAGIC[8] = "UWUCAP1";
+
+// The types of records inside a capture file.
+typedef enum {
+  CAPTURE_OPEN = 1,
+  CAPTURE_FRAME,
+  CAPTURE_CLOSE,
+} UWU_CaptureRecord;
+
+// The most bytes a varint can take.
+#define UWU_VARINT_MAX_LENGTH 10
+
+// Writes `value` as a LEB128 varint into `dest`, returns the bytes written.
+// `dest` must have space for `UWU_VARINT_MAX_LENGTH` bytes.
+size_t UWU_Varint_write(uint8_t *dest, uint64_t value) {
+  size_t length = 0;
+  do {
+    uint8_t byte = value & 0x7F;
+    value >>= 7;
+    dest[length++] = byte | (value > 0 ? 0x80 : 0);
+  } while (value > 0);
+  return length;
+}
+
+// Reads a LEB128 varint from `data` starting at `*offset`, which is moved past
+// it. Returns `FALSE` if the varint is truncated or too long.
+UWU_Bool UWU_Varint_read(const uint8_t *data, size_t length, size_t *offset,
+                         uint64_t *value) {
+  *value = 0;
+  for (size_t i = 0; i < UWU_VARINT_MAX_LENGTH; i++) {
+    if (*offset >= length) {
+      return FALSE;
+    }
+
+    uint8_t byte = data[(*offset)++];
+    *value |= (uint64_t)(byte & 0x7F) << (7 * i);
+    if ((byte & 0x80) == 0) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
 /* *****************************************************************************
 Arenas
 ***************************************************************************** */
@@ -118,7 +662,7 @@ typedef struct {
 // Initializes a new arena with the specified capacity!
 UWU_Arena UWU_Arena_init(size_t capacity, UWU_Err err) {
   UWU_Arena arena = {};
-  arena.data = malloc(sizeof(uint8_t) * capacity);
+  arena.data = UWU_malloc(UWU_ALLOC_ARENAS, sizeof(uint8_t) * capacity);
 
   if (arena.data == NULL) {
     err = MALLOC_FAILED;
@@ -160,7 +704,268 @@ void UWU_Arena_reset(UWU_Arena *arena) { arena->size = 0; }
 void UWU_Arena_deinit(UWU_Arena arena) {
   arena.capacity = 0;
   arena.size = 0;
-  free(arena.data);
+  UWU_free(arena.data);
+}
+
+/* *****************************************************************************
+Token Buckets
+***************************************************************************** */
+
+// A token bucket limits how often something can happen.
+//
+// The bucket holds up to `capacity` tokens and gains `rate` tokens per second.
+// Every action takes one token, if there are none left the action should be
+// rejected. A bucket with a `rate` of 0 never runs out of tokens.
+typedef struct {
+  // The max amount of tokens, this is the size of the allowed bursts.
+  double capacity;
+  // The amount of tokens gained per second.
+  double rate;
+  // The amount of tokens available right now.
+  double tokens;
+  // The last time tokens were added to the bucket.
+  struct timespec last_refill;
+} UWU_TokenBucket;
+
+// Creates a new full bucket.
+// It always holds at least one token, so fractional rates still let requests
+// through.
+UWU_TokenBucket UWU_TokenBucket_init(double rate, double capacity,
+                                     struct timespec now) {
+  if (capacity < 1) {
+    capacity = 1;
+  }
+
+  UWU_TokenBucket bucket = {
+      .capacity = capacity,
+      .rate = rate,
+      .tokens = capacity,
+      .last_refill = now,
+  };
+
+  return bucket;
+}
+
+// Tries to take a token from the bucket.
+// Returns `TRUE` if a token was taken, `FALSE` if the bucket is empty.
+UWU_Bool UWU_TokenBucket_take(UWU_TokenBucket *bucket, struct timespec now) {
+  if (bucket->rate <= 0) {
+    return TRUE;
+  }
+
+  double elapsed = (double)(now.tv_sec - bucket->last_refill.tv_sec) +
+                   (double)(now.tv_nsec - bucket->last_refill.tv_nsec) / 1e9;
+  if (elapsed > 0) {
+    bucket->tokens += elapsed * bucket->rate;
+    if (bucket->tokens > bucket->capacity) {
+      bucket->tokens = bucket->capacity;
+    }
+    bucket->last_refill = now;
+  }
+
+  if (bucket->tokens < 1) {
+    return FALSE;
+  }
+
+  bucket->tokens -= 1;
+  return TRUE;
+}
+
+// Gives back a token previously taken from the bucket.
+void UWU_TokenBucket_refund(UWU_TokenBucket *bucket) {
+  bucket->tokens += 1;
+  if (bucket->tokens > bucket->capacity) {
+    bucket->tokens = bucket->capacity;
+  }
+}
+
+/* *****************************************************************************
+Histograms
+***************************************************************************** */
+
+// The amount of bits used to split every power of two into sub buckets.
+// 16 sub buckets per power of two keep the error of every value under ~6%.
+#define UWU_HISTOGRAM_SUB_BITS 4
+#define UWU_HISTOGRAM_SUB_BUCKETS (1 << UWU_HISTOGRAM_SUB_BITS)
+// Enough buckets to hold any 64 bits value.
+#define UWU_HISTOGRAM_BUCKETS                                                  \
+  ((64 - UWU_HISTOGRAM_SUB_BITS + 1) * UWU_HISTOGRAM_SUB_BUCKETS)
+
+// A log-linear histogram (HDR style) of positive values, usually nanoseconds.
+//
+// Every power of two is split into `UWU_HISTOGRAM_SUB_BUCKETS` linear buckets,
+// so it has high resolution for small values and a wide range at the same
+// time. Recording only uses atomic adds, so it can be shared by many threads
+// without locks.
+typedef struct {
+  // The amount of values recorded on each bucket.
+  size_t counts[UWU_HISTOGRAM_BUCKETS];
+  // The amount of values recorded.
+  size_t total;
+  // The sum of every value recorded.
+  uint64_t sum;
+  // The biggest value recorded.
+  uint64_t max;
+} UWU_Histogram;
+
+// Returns the index of the bucket that holds `value`.
+size_t UWU_Histogram_bucketIdx(uint64_t value) {
+  if (value < UWU_HISTOGRAM_SUB_BUCKETS) {
+    return value;
+  }
+
+  size_t exponent = 63 - __builtin_clzll(value);
+  size_t sub_bucket = (value >> (exponent - UWU_HISTOGRAM_SUB_BITS)) &
+                      (UWU_HISTOGRAM_SUB_BUCKETS - 1);
+
+  return (exponent - UWU_HISTOGRAM_SUB_BITS + 1) * UWU_HISTOGRAM_SUB_BUCKETS +
+         sub_bucket;
+}
+
+// Returns the biggest value that can be recorded on the bucket `idx`.
+uint64_t UWU_Histogram_bucketUpperBound(size_t idx) {
+  if (idx < UWU_HISTOGRAM_SUB_BUCKETS) {
+    return idx;
+  }
+
+  size_t exponent =
+      idx / UWU_HISTOGRAM_SUB_BUCKETS + UWU_HISTOGRAM_SUB_BITS - 1;
+  size_t sub_bucket = idx % UWU_HISTOGRAM_SUB_BUCKETS;
+  size_t shift = exponent - UWU_HISTOGRAM_SUB_BITS;
+
+  uint64_t lower_bound = (uint64_t)(UWU_HISTOGRAM_SUB_BUCKETS + sub_bucket)
+                         << shift;
+  return lower_bound + (((uint64_t)1 << shift) - 1);
+}
+
+// Records a new value on the histogram.
+// It's safe to call from multiple threads at the same time.
+void UWU_Histogram_record(UWU_Histogram *hist, uint64_t value) {
+  size_t idx = UWU_Histogram_bucketIdx(value);
+  __atomic_fetch_add(&hist->counts[idx], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&hist->total, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&hist->sum, value, __ATOMIC_RELAXED);
+
+  uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+  while (value > max &&
+         !__atomic_compare_exchange_n(&hist->max, &max, value, TRUE,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+// Adds all the values recorded on `src` into `dest`.
+void UWU_Histogram_merge(UWU_Histogram *dest, UWU_Histogram *src) {
+  for (size_t i = 0; i < UWU_HISTOGRAM_BUCKETS; i++) {
+    dest->counts[i] += src->counts[i];
+  }
+  dest->total += src->total;
+  dest->sum += src->sum;
+  if (src->max > dest->max) {
+    dest->max = src->max;
+  }
+}
+
+// Removes the values recorded on `older` from `dest`, where `older` is an
+// earlier copy of `dest`. What's left are the values recorded since the copy.
+//
+// The max can't be removed, so it becomes the upper bound of the biggest bucket
+// left, or stays the same if that bucket also holds it.
+void UWU_Histogram_subtract(UWU_Histogram *dest, UWU_Histogram *older) {
+  size_t biggest = 0;
+  for (size_t i = 0; i < UWU_HISTOGRAM_BUCKETS; i++) {
+    dest->counts[i] -= older->counts[i];
+    biggest = dest->counts[i] > 0 ? i : biggest;
+  }
+  dest->total -= older->total;
+  dest->sum -= older->sum;
+
+  uint64_t upper_bound = UWU_Histogram_bucketUpperBound(biggest);
+  if (dest->total == 0) {
+    dest->max = 0;
+  } else if (upper_bound < dest->max) {
+    dest->max = upper_bound;
+  }
+}
+
+// Returns the value under which `percentile` (0 to 100) percent of the
+// recorded values fall. Returns 0 if the histogram is empty.
+uint64_t UWU_Histogram_percentile(UWU_Histogram *hist, double percentile) {
+  size_t total = __atomic_load_n(&hist->total, __ATOMIC_RELAXED);
+  if (total == 0) {
+    return 0;
+  }
+
+  size_t target = (size_t)((percentile / 100.0) * total + 0.5);
+  if (target == 0) {
+    target = 1;
+  }
+
+  size_t seen = 0;
+  for (size_t i = 0; i < UWU_HISTOGRAM_BUCKETS; i++) {
+    seen += __atomic_load_n(&hist->counts[i], __ATOMIC_RELAXED);
+    if (seen >= target) {
+      uint64_t upper_bound = UWU_Histogram_bucketUpperBound(i);
+      return upper_bound < hist->max ? upper_bound : hist->max;
+    }
+  }
+
+  return hist->max;
+}
+
+// Writes the percentile distribution of the histogram on the format of
+// HdrHistogram (.hgrm files), so the usual plotters can read it.
+//
+// Every value is divided by `unit`, for example 1e3 to print nanoseconds as
+// microseconds. Values are the upper bound of their bucket, so the mean and
+// deviation are approximations.
+void UWU_Histogram_printPercentiles(FILE *out, UWU_Histogram *hist,
+                                    double unit) {
+  size_t total = hist->total;
+  double mean = 0;
+  for (size_t i = 0; i < UWU_HISTOGRAM_BUCKETS && total > 0; i++) {
+    mean += (double)UWU_Histogram_bucketUpperBound(i) * hist->counts[i] / total;
+  }
+  double variance = 0;
+  for (size_t i = 0; i < UWU_HISTOGRAM_BUCKETS && total > 0; i++) {
+    double delta = (double)UWU_Histogram_bucketUpperBound(i) - mean;
+    variance += delta * delta * hist->counts[i] / total;
+  }
+
+  fprintf(out, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount",
+          "1/(1-Percentile)");
+
+  size_t seen = 0;
+  for (size_t i = 0; i < UWU_HISTOGRAM_BUCKETS && seen < total; i++) {
+    if (hist->counts[i] == 0) {
+      continue;
+    }
+    seen += hist->counts[i];
+
+    uint64_t value = UWU_Histogram_bucketUpperBound(i);
+    value = value < hist->max ? value : hist->max;
+    double percentile = (double)seen / total;
+
+    if (seen < total) {
+      fprintf(out, "%12.3f %2.12f %10zu %14.2f\n", value / unit, percentile,
+              seen, 1 / (1 - percentile));
+    } else {
+      fprintf(out, "%12.3f %2.12f %10zu\n", value / unit, percentile, seen);
+    }
+  }
+
+  fprintf(out, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", mean / unit,
+          __builtin_sqrt(variance) / unit);
+  fprintf(out, "#[Max     = %12.3f, Total count    = %12zu]\n",
+          hist->max / unit, total);
+  fprintf(out, "#[Buckets = %12d, SubBuckets     = %12d]\n",
+          UWU_HISTOGRAM_BUCKETS, UWU_HISTOGRAM_SUB_BUCKETS);
+}
+
+// Returns the current time of the monotonic clock in nanoseconds.
+uint64_t UWU_monotonicNs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
 }
 
 /* *****************************************************************************
@@ -234,7 +1039,7 @@ UWU_Bool UWU_String_firstGoesFirst(UWU_String *first, UWU_String *other) {
 // The caller owns the resulting string.
 UWU_String UWU_String_combineWithOther(UWU_String *first, UWU_String *second) {
   UWU_String str = {.length = first->length + second->length};
-  str.data = malloc(str.length);
+  str.data = UWU_malloc(UWU_ALLOC_STRINGS, str.length);
 
   if (str.data == NULL) {
     UWU_PANIC("Malloc failed when trying to combine two strings!");
@@ -254,7 +1059,7 @@ UWU_String UWU_String_combineWithOther(UWU_String *first, UWU_String *second) {
 UWU_String UWU_String_tryCombineWithOther(UWU_String *first, UWU_String *second,
                                           UWU_Err err) {
   UWU_String str = {.length = first->length + second->length};
-  str.data = malloc(str.length);
+  str.data = UWU_malloc(UWU_ALLOC_STRINGS, str.length);
 
   if (str.data == NULL) {
     err = MALLOC_FAILED;
@@ -268,13 +1073,14 @@ UWU_String UWU_String_tryCombineWithOther(UWU_String *first, UWU_String *second,
   return str;
 }
 
-// Frees the specified `UWU_String` that was originally allocated by a `malloc`
-// call. This function ONLY FREES THE `data` field inside `UWU_String`.
-void UWU_String_freeWithMalloc(UWU_String *str) { free(str->data); }
+// Frees the specified `UWU_String` that was originally allocated by a
+// `UWU_malloc` call. This function ONLY FREES THE `data` field inside
+// `UWU_String`.
+void UWU_String_freeWithMalloc(UWU_String *str) { UWU_free(str->data); }
 
 // Attempts to converts from a `UWU_String` to a null terminated string.
 char *UWU_String_tryToCStr(UWU_String *str, UWU_Err err) {
-  char *c_str = malloc(str->length + 1);
+  char *c_str = UWU_malloc(UWU_ALLOC_STRINGS, str->length + 1);
 
   if (c_str == NULL) {
     err = MALLOC_FAILED;
@@ -293,7 +1099,7 @@ char *UWU_String_tryToCStr(UWU_String *str, UWU_Err err) {
 //
 // If malloc fails then panics.
 char *UWU_String_toCStr(UWU_String *str) {
-  char *c_str = malloc(str->length + 1);
+  char *c_str = UWU_malloc(UWU_ALLOC_STRINGS, str->length + 1);
 
   if (c_str == NULL) {
     UWU_PANIC("Can't convert UWU_String into C_str! (len: %d, data: %s)",
@@ -334,7 +1140,7 @@ UWU_String UWU_String_copyFromFio(FIOBJ obj, UWU_Err err) {
   }
 
   fio_str_info_s c_str = fiobj_obj2cstr(obj);
-  char *data = malloc(c_str.len);
+  char *data = UWU_malloc(UWU_ALLOC_STRINGS, c_str.len);
   for (size_t i = 0; i < c_str.len; i++) {
     data[i] = c_str.data[i];
   }
@@ -348,7 +1154,7 @@ UWU_String UWU_String_copyFromFio(FIOBJ obj, UWU_Err err) {
 // Copies `src` into a new `UWU_String`.
 UWU_String UWU_String_copy(UWU_String *src, UWU_Err err) {
   UWU_String str = {};
-  str.data = malloc(src->length);
+  str.data = UWU_malloc(UWU_ALLOC_STRINGS, src->length);
 
   if (src->data == NULL) {
     err = MALLOC_FAILED;
@@ -369,7 +1175,7 @@ uint8_t UWU_String_getChar(UWU_String *str, size_t idx) {
   char *c_str = UWU_String_toCStr(str);
 
   UWU_PANIC("Out of bound access on String `%s` with Idx `%d`", c_str, idx);
-  free(c_str);
+  UWU_free(c_str);
 
   return 0;
 }
@@ -449,7 +1255,8 @@ struct UWU_UserListNode UWU_UserListNode_newWithValue(UWU_User data) {
 // Creates a copy from `other` and allocates it on the heap.
 struct UWU_UserListNode *UWU_UserListNode_copy(struct UWU_UserListNode *other,
                                                UWU_Err err) {
-  struct UWU_UserListNode *copy = malloc(sizeof(struct UWU_UserListNode));
+  struct UWU_UserListNode *copy =
+      UWU_malloc(UWU_ALLOC_USERS, sizeof(struct UWU_UserListNode));
   if (copy == NULL) {
     err = MALLOC_FAILED;
     return NULL;
@@ -566,10 +1373,13 @@ void UWU_UserList_deinit(UWU_UserList *list) {
     struct UWU_UserListNode *tmp = current;
     current = current->next;
     UWU_UserListNode_deinit(tmp);
+    if (!tmp->is_sentinel) {
+      UWU_free(tmp);
+    }
   }
 
-  free(list->end);
-  free(list->start);
+  UWU_free(list->end);
+  UWU_free(list->start);
 }
 
 // Inserts a specified node to the start of the list.
@@ -643,8 +1453,8 @@ void UWU_UserList_removeByUsernameIfExists(UWU_UserList *list,
       next->previous = current->previous;
 
       UWU_UserListNode_deinit(current);
-      free(current); // The node is always on the heap thanks to
-                     // `UWU_UserListNode_copy`!
+      UWU_free(current); // The node is always on the heap thanks to
+                         // `UWU_UserListNode_copy`!
       list->length -= 1;
       current = previous;
     }
@@ -660,6 +1470,8 @@ typedef struct {
   UWU_String content;
   // The username of the person sending the message.
   UWU_String origin_username;
+  // When the message was received by the server, 0 if unknown.
+  time_t sent_at;
 } UWU_ChatEntry;
 
 UWU_ChatEntry UWU_ChatEntry_copy(UWU_ChatEntry *src, UWU_Err err) {
@@ -677,6 +1489,7 @@ UWU_ChatEntry UWU_ChatEntry_copy(UWU_ChatEntry *src, UWU_Err err) {
   UWU_ChatEntry dest = {
       .content = content_copy,
       .origin_username = username_copy,
+      .sent_at = src->sent_at,
   };
 
   return dest;
@@ -688,22 +1501,36 @@ void UWU_ChatEntry_free(UWU_ChatEntry *src) {
 }
 // Represents a message history of a certain chat
 //
-// Messages are stored on the `*messages` buffer. If the buffer is full the
-// oldest data is overridden.
+// Messages are stored on the `*messages` buffer. The buffer grows until it
+// reaches `max_capacity`, after that the oldest data is overridden.
 //
 // To iterate the data in order please obtain an iterator using:
 // `UWU_ChatHistory_iter()`
-typedef struct {
+typedef struct UWU_ChatHistory {
   // A pointer to an array of `ChatEntry`.
   UWU_ChatEntry *messages;
   // The name of the channel that points to this history the server state
   UWU_String channel_name;
   // The number of chat messages filling the array.
+  // It never goes past `capacity`.
   size_t count;
   // How much memory is left in the array of `ChatEntry`.
   size_t capacity;
+  // The max value `capacity` can grow to.
+  size_t max_capacity;
   // The idx of the next message to insert in the array.
   size_t next_idx;
+  // The amount of heap bytes held by the history, its entries and its channel
+  // name. Doesn't include the `UWU_ChatHistory` itself.
+  size_t memory;
+  // The histories used right after and right before this one, so the owner
+  // can keep them in a list sorted by use without allocating.
+  struct UWU_ChatHistory *newer;
+  struct UWU_ChatHistory *older;
+  // Lets the owner tell apart histories with the same channel name, like the
+  // ones of two users that registered the same username one after the other.
+  // By default is 0.
+  uint64_t id;
 } UWU_ChatHistory;
 
 // Creates a new ChatHistory with the specified capacity for messages.
@@ -711,34 +1538,91 @@ UWU_ChatHistory UWU_ChatHistory_init(size_t capacity, UWU_String channel_name,
                                      UWU_Err err) {
   UWU_ChatHistory ht = {};
 
-  ht.messages = malloc(sizeof(UWU_ChatEntry[capacity]));
+  ht.messages =
+      UWU_malloc(UWU_ALLOC_HISTORIES, sizeof(UWU_ChatEntry[capacity]));
   if (ht.messages == NULL) {
     err = MALLOC_FAILED;
     return ht;
   }
 
   ht.capacity = capacity;
+  ht.max_capacity = capacity;
   ht.count = 0;
   ht.next_idx = 0;
   ht.channel_name = channel_name;
+  ht.memory = sizeof(UWU_ChatEntry[capacity]) + channel_name.length;
 
   return ht;
 }
 
+// Returns the heap bytes held by the strings of an entry.
+static size_t UWU_ChatEntry_memory(UWU_ChatEntry *entry) {
+  return entry->content.length + entry->origin_username.length;
+}
+
+// `TRUE` if the messages of the history were evicted.
+UWU_Bool UWU_ChatHistory_isEvicted(UWU_ChatHistory *ht) {
+  return NULL == ht->messages;
+}
+
+// Frees all the messages of the history, keeping only its channel name.
+//
+// The history can still be used, it's restored empty by the next
+// `UWU_ChatHistory_addMessage`.
+void UWU_ChatHistory_evict(UWU_ChatHistory *ht) {
+  if (UWU_ChatHistory_isEvicted(ht)) {
+    return;
+  }
+
+  for (size_t i = 0; i < ht->count; i++) {
+    UWU_ChatEntry_free(&ht->messages[i]);
+  }
+  UWU_free(ht->messages);
+
+  ht->messages = NULL;
+  ht->count = 0;
+  ht->next_idx = 0;
+  ht->memory = ht->channel_name.length;
+}
+
+// Allocates the messages of an evicted history again.
+void UWU_ChatHistory_restore(UWU_ChatHistory *ht, UWU_Err err) {
+  if (!UWU_ChatHistory_isEvicted(ht)) {
+    return;
+  }
+
+  ht->messages =
+      UWU_malloc(UWU_ALLOC_HISTORIES, sizeof(UWU_ChatEntry[ht->capacity]));
+  if (ht->messages == NULL) {
+    err = MALLOC_FAILED;
+    return;
+  }
+
+  ht->memory += sizeof(UWU_ChatEntry[ht->capacity]);
+}
+
 void UWU_ChatHistory_deinit(UWU_ChatHistory *ht) {
   for (size_t i = 0; i < ht->count; i++) {
     UWU_ChatEntry_free(&ht->messages[i]);
   }
-  free(ht->messages);
+  UWU_free(ht->messages);
   UWU_String_freeWithMalloc(&ht->channel_name);
 }
 
 // Adds a new entry to the ChatHistory.
 //
-// If the ChatHistory is already full then it wraps around and adds it to the
-// back.
+// If the ChatHistory is already full then it wraps around and replaces the
+// oldest entry, which is freed.
+//
+// An evicted history is restored before adding the entry.
 void UWU_ChatHistory_addMessage(UWU_ChatHistory *hist, UWU_ChatEntry *entry) {
   UWU_Err err = NO_ERROR;
+  UWU_ChatHistory_restore(hist, err);
+  if (err != NO_ERROR) {
+    UWU_PANIC("Fatal: Failed to restore an evicted chat history!");
+    return;
+  }
+
   size_t next_idx = hist->next_idx % hist->capacity;
   UWU_ChatEntry clone = UWU_ChatEntry_copy(entry, err);
   if (err != NO_ERROR) {
@@ -746,12 +1630,129 @@ void UWU_ChatHistory_addMessage(UWU_ChatHistory *hist, UWU_ChatEntry *entry) {
     return;
   }
 
-  hist->messages[next_idx] = clone;
+  // A shrunk buffer grows back before overriding anything. It never wrapped
+  // since it was shrunk so the entries are still in order.
+  if (hist->count >= hist->capacity && hist->capacity < hist->max_capacity) {
+    size_t new_capacity = hist->capacity * 2;
+    if (new_capacity > hist->max_capacity) {
+      new_capacity = hist->max_capacity;
+    }
+
+    UWU_ChatEntry *messages = UWU_realloc(UWU_ALLOC_HISTORIES, hist->messages,
+                                          sizeof(UWU_ChatEntry[new_capacity]));
+    if (NULL == messages) {
+      UWU_PANIC("Fatal: Failed to grow chat history!");
+      return;
+    }
+
+    hist->memory += sizeof(UWU_ChatEntry[new_capacity - hist->capacity]);
+    hist->messages = messages;
+    hist->capacity = new_capacity;
+    next_idx = hist->next_idx % hist->capacity;
+  }
+
+  if (hist->count >= hist->capacity) {
+    hist->memory -= UWU_ChatEntry_memory(&hist->messages[next_idx]);
+    UWU_ChatEntry_free(&hist->messages[next_idx]);
+  } else {
+    hist->count += 1;
+  }
 
-  hist->count += 1;
+  hist->messages[next_idx] = clone;
+  hist->memory += UWU_ChatEntry_memory(&clone);
   hist->next_idx += 1;
 }
 
+// Returns the amount of heap bytes held by the history, its entries and its
+// channel name. Doesn't include the `UWU_ChatHistory` itself.
+size_t UWU_ChatHistory_memory(UWU_ChatHistory *hist) { return hist->memory; }
+
+// `TRUE` if the next message overrides the oldest one.
+UWU_Bool UWU_ChatHistory_isFull(UWU_ChatHistory *hist) {
+  return hist->count >= hist->max_capacity;
+}
+
+// Frees all the entries sent before `cutoff` and moves the rest to the start
+// of the buffer, keeping their order.
+//
+// Returns the amount of entries freed.
+size_t UWU_ChatHistory_expire(UWU_ChatHistory *hist, time_t cutoff) {
+  if (UWU_ChatHistory_isEvicted(hist) || hist->count == 0) {
+    return 0;
+  }
+
+  size_t start =
+      hist->count >= hist->capacity ? hist->next_idx % hist->capacity : 0;
+  size_t expired = 0;
+  while (expired < hist->count &&
+         hist->messages[(start + expired) % hist->capacity].sent_at < cutoff) {
+    UWU_ChatEntry *entry = &hist->messages[(start + expired) % hist->capacity];
+    hist->memory -= UWU_ChatEntry_memory(entry);
+    UWU_ChatEntry_free(entry);
+    expired++;
+  }
+
+  if (expired == 0) {
+    return 0;
+  }
+
+  size_t remaining = hist->count - expired;
+  if (start == 0) {
+    memmove(hist->messages, &hist->messages[expired],
+            sizeof(UWU_ChatEntry[remaining]));
+  } else {
+    UWU_ChatEntry *messages =
+        UWU_malloc(UWU_ALLOC_HISTORIES, sizeof(UWU_ChatEntry[hist->capacity]));
+    if (NULL == messages) {
+      UWU_PANIC("Fatal: Failed to compact chat history!");
+      return expired;
+    }
+
+    for (size_t i = 0; i < remaining; i++) {
+      messages[i] = hist->messages[(start + expired + i) % hist->capacity];
+    }
+    UWU_free(hist->messages);
+    hist->messages = messages;
+  }
+
+  hist->count = remaining;
+  hist->next_idx = remaining;
+  return expired;
+}
+
+// Halves the buffer while at most a quarter of it is used, without going
+// under `min_capacity`. The buffer grows back when new messages need it.
+//
+// Returns `TRUE` if the buffer shrunk.
+UWU_Bool UWU_ChatHistory_shrink(UWU_ChatHistory *hist, size_t min_capacity) {
+  if (UWU_ChatHistory_isEvicted(hist)) {
+    return FALSE;
+  }
+
+  // Only a buffer that isn't full can be sparse, so it never wrapped and the
+  // entries are at the start.
+  size_t new_capacity = hist->capacity;
+  while (hist->count <= new_capacity / 4 && new_capacity / 2 >= min_capacity) {
+    new_capacity /= 2;
+  }
+
+  if (new_capacity == hist->capacity) {
+    return FALSE;
+  }
+
+  UWU_ChatEntry *messages = UWU_realloc(UWU_ALLOC_HISTORIES, hist->messages,
+                                        sizeof(UWU_ChatEntry[new_capacity]));
+  if (NULL == messages) {
+    // The old buffer is still valid, just keep using it.
+    return FALSE;
+  }
+
+  hist->memory -= sizeof(UWU_ChatEntry[hist->capacity - new_capacity]);
+  hist->messages = messages;
+  hist->capacity = new_capacity;
+  return TRUE;
+}
+
 // Gives limits for iterating over a `UWU_ChatHistory` in insertion order.
 // `start` and `end` ARE NOT indexes! Make sure to apply the % operator
 // because they can grow far beyond what the collection could hold!
@@ -0,0 +1,2408 @@
+/**
+A load generator for the UwuChat server.
+
+It opens many WebSocket connections, each one with a unique username, and sends
+a configurable mix of requests at a fixed rate. The schedule is open loop: a
+slow server doesn't slow down the requests, so the latencies reported include
+the time requests spend queued on the server.
+
+Latencies are measured from the time a request was scheduled to be sent, not
+from the time it was actually written. A stalled server or load generator can't
+hide the requests it delayed (coordinated omission), they show up as the latency
+they would have had for a real client.
+
+At the end it reports the throughput, the errors the server answered with and
+the latency percentiles of every kind of request. Messages are also measured on
+delivery: every connection that receives a message sent by another one records
+how long it took to arrive.
+
+With `-churn` new users keep joining and leaving while the load runs, which
+measures how long the handshake and the close take and how much they slow down
+the rest of the requests. Compare runs with growing `-c` to see how they scale.
+
+With `-idle 10000,50000,100000` no requests are sent: the connections are
+opened up to every amount listed and, once they settled, the memory of the
+server per connection and the CPU its idle detector uses are read from
+`/metrics`. One source address can only open about 28k connections to a single
+server address. For bigger amounts list more URLs with other loopback addresses
+(127.0.0.2, 127.0.0.3...) and run the server listening on every address.
+
+`-fanout 10,1000,50000` does the same but then sends group messages one at a
+time, of every `-fanout-sizes`, measuring how long they take to reach every
+connection, the server CPU each one costs and the outbound throughput.
+
+With `-soak` the mix runs for `-duration` while the memory of the server and the
+latencies are sampled. It fails (exits with 1) if the RSS, the live allocations
+or the p99 latency grew more than allowed between the start and the end.
+
+`-duplicates 20` checks that a username is only taken once, even by users
+joining different partitions of a `-partitioned` server at the same time. On
+every round all the connections are opened at once with the same username and,
+after `-settle` seconds, exactly one of them must be left open. It fails (exits
+with 1) otherwise.
+
+With `-probe` only messages are sent, which makes it an end to end delivery
+latency probe. `-hgrm` writes the histograms on the HdrHistogram format.
+
+The per connection rate limits of the server would reject most of the load, so
+run it without them:
+
+    zig build run -- -b 127.0.0.1 -p 8080 -cr 0 -er 0 -hr 0
+
+And then:
+
+    zig build load_client -- -u ws://127.0.0.1:8080/ -c 1000 -r 5000 -d 30
+
+Use the same `-seed` and flags on every run so the results of two builds can be
+compared.
+
+Instead of the synthetic mix it can also replay the traffic a server captured
+with `-capture`, keeping the timing between frames (scaled by `-speed`):
+
+    zig build load_client -- -u ws://127.0.0.1:8080/ -replay traffic.cap
+
+The captured usernames are reused, so replay against a fresh server.
+*/
+#include "fio_cli.h"
+#include "lib.c"
+#include "websockets.h"
+#include <errno.h>
+#include <limits.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* *****************************************************************************
+Constants
+***************************************************************************** */
+
+// How often the scheduler runs. Every run sends all the requests that are due.
+const size_t TICK_MS = 1;
+// The amount of requests a connection can wait on. Older requests are counted
+// as unanswered once a new one doesn't fit.
+#define MAX_PENDING 32
+// Marks the content of the messages sent by the load generator, followed by the
+// index of the sender connection and the time it was sent.
+const char MESSAGE_MARKER = '#';
+// The message length is sent in a single byte.
+#define MAX_MESSAGE_SIZE 255
+// Enough space for `MESSAGE_MARKER`, the index and the send time.
+#define MIN_MESSAGE_SIZE 32
+
+// How many URLs `-url` can list.
+#define MAX_URLS 16
+
+/* *****************************************************************************
+Requests
+***************************************************************************** */
+
+// All the kinds of requests the load generator sends.
+typedef enum {
+  LOAD_GROUP_MESSAGE,
+  LOAD_DIRECT_MESSAGE,
+  LOAD_GET_MESSAGES,
+  LOAD_LIST_USERS,
+  LOAD_CHANGE_STATUS,
+  LOAD_GET_USER,
+  LOAD_KINDS_COUNT,
+} UWU_LoadKind;
+
+// The flag that sets the weight of every kind, also used on the report.
+static const char *LOAD_KIND_NAMES[LOAD_KINDS_COUNT] = {
+    "group", "dm", "history", "list", "status", "user"};
+
+// A request still waiting for its response.
+typedef struct {
+  uint64_t sent_at;
+  // Tells apart the answer from other frames of the same type, for example the
+  // content of a message. 0 if any frame of the type answers it.
+  uint64_t key;
+  UWU_LoadKind kind;
+} UWU_PendingRequest;
+
+// The requests of a connection still waiting for their response, in the order
+// they were sent.
+//
+// The server answers the requests of a connection in order, so the oldest
+// pending request of a kind is the one being answered.
+typedef struct {
+  UWU_PendingRequest requests[MAX_PENDING];
+  size_t start;
+  size_t count;
+} UWU_LoadPending;
+
+// Delivery latencies of the messages, as seen by their receivers.
+typedef enum {
+  DELIVERY_GROUP,
+  DELIVERY_DIRECT,
+  DELIVERY_KINDS_COUNT,
+} UWU_DeliveryKind;
+
+static const char *DELIVERY_KIND_NAMES[DELIVERY_KINDS_COUNT] = {"group",
+                                                                "dm"};
+
+// The counters of a kind of request.
+typedef struct {
+  size_t sent;
+  size_t answered;
+  // Requests that were dropped from the pending slots before being answered.
+  size_t unanswered;
+  UWU_Histogram latency;
+} UWU_LoadKindStats;
+
+/* *****************************************************************************
+Connections
+***************************************************************************** */
+
+typedef struct {
+  size_t idx;
+  char name[255 + 1]; // 255 is the max username length!
+  uint8_t name_length;
+  // NULL while the connection is not open.
+  //
+  // The scheduler writes from its own thread, so it's only used while holding
+  // `lock`.
+  ws_s *ws;
+  fio_lock_i lock;
+  // The status the server has for this user, used to send valid transitions.
+  UWU_ConnStatus status;
+  // Messages carry their send time on their content, they only wait here when
+  // replaying a capture.
+  UWU_LoadPending pending;
+  // `TRUE` once the load generator itself started closing the connection.
+  UWU_Bool is_leaving;
+
+  // Churn connections close as soon as they open, and their slot is reused by
+  // a new user once they're closed.
+  UWU_Bool is_churn;
+  UWU_Bool is_busy;
+  // When the churn connection was due to be opened.
+  uint64_t connect_due_at;
+  uint64_t close_started_at;
+} UWU_LoadConn;
+
+typedef struct {
+  size_t opened;
+  size_t failed;
+  // Connections closed by the server while the load was running.
+  size_t closed;
+  size_t open;
+} UWU_ConnStats;
+
+typedef struct {
+  size_t started;
+  size_t opened;
+  size_t closed;
+  size_t failed;
+  // Churns that were due while every slot was still busy.
+  size_t skipped;
+} UWU_ChurnStats;
+
+/* *****************************************************************************
+State
+***************************************************************************** */
+
+static char *URL = NULL;
+// `URL` split on commas, connections are spread over them.
+static char *URLS[MAX_URLS] = {};
+static size_t URLS_COUNT = 0;
+static size_t CONNECTIONS = 0;
+static size_t CONNECT_RATE = 0;
+static size_t RATE = 0;
+static size_t DURATION_SECONDS = 0;
+static size_t MESSAGE_SIZE = 0;
+static size_t WEIGHTS[LOAD_KINDS_COUNT] = {};
+static size_t TOTAL_WEIGHT = 0;
+// Connections opened and closed per second on top of `CONNECTIONS`.
+static size_t CHURN_RATE = 0;
+
+static UWU_LoadConn *conns = NULL;
+static UWU_ConnStats conn_stats = {};
+static UWU_LoadKindStats kind_stats[LOAD_KINDS_COUNT] = {};
+// Indexed by the UWU_Errors code the server sent.
+static size_t error_counts[USERNAME_TAKEN + 1] = {};
+static size_t unknown_frames = 0;
+static UWU_Histogram delivery_latency[DELIVERY_KINDS_COUNT] = {};
+// Requests that were due but had no open connection to be sent from.
+static size_t skipped_requests = 0;
+
+static UWU_LoadConn *churn_conns = NULL;
+static size_t churn_slots = 0;
+static UWU_ChurnStats churn_stats = {};
+// From the time the connection was due to the time it was open.
+static UWU_Histogram handshake_latency = {};
+// From the time the close was sent to the time the server closed it.
+static UWU_Histogram close_latency = {};
+
+// Only one run of the scheduler at a time, it also guards `rng_state`.
+static fio_lock_i tick_lock = FIO_LOCK_INIT;
+static uint64_t rng_state = 0;
+static size_t connects_started = 0;
+static uint64_t ramp_started_at = 0;
+// Zero while the connections are still being opened.
+static uint64_t run_started_at = 0;
+static size_t requests_scheduled = 0;
+static size_t churns_scheduled = 0;
+static size_t last_progress_second = 0;
+static size_t last_progress_answered = 0;
+
+// xorshift64*, good enough to pick connections and kinds reproducibly.
+uint64_t next_random() {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+// Returns the amount of answers received for every kind of request.
+size_t total_answered() {
+  size_t total = 0;
+  for (size_t i = 0; i < LOAD_KINDS_COUNT; i++) {
+    total += fio_atomic_add(&kind_stats[i].answered, 0);
+  }
+  return total;
+}
+
+/* *****************************************************************************
+Pending requests
+***************************************************************************** */
+
+// Saves a new request of `kind` sent at `sent_at`.
+// Must be called while holding the lock of the connection.
+void pending_push(UWU_LoadPending *pending, UWU_LoadKind kind,
+                  uint64_t sent_at, uint64_t key) {
+  if (pending->count == MAX_PENDING) {
+    UWU_LoadKind oldest = pending->requests[pending->start].kind;
+    fio_atomic_add(&kind_stats[oldest].unanswered, 1);
+    pending->start = (pending->start + 1) % MAX_PENDING;
+    pending->count--;
+  }
+
+  size_t idx = (pending->start + pending->count) % MAX_PENDING;
+  UWU_PendingRequest request = {.sent_at = sent_at, .key = key, .kind = kind};
+  pending->requests[idx] = request;
+  pending->count++;
+}
+
+// Records the latency of the oldest request of `kind` if `key` matches it.
+// Returns `FALSE` if the frame doesn't answer any request.
+// Must be called while holding the lock of the connection.
+UWU_Bool pending_answer(UWU_LoadPending *pending, UWU_LoadKind kind,
+                        uint64_t key) {
+  for (size_t i = 0; i < pending->count; i++) {
+    size_t idx = (pending->start + i) % MAX_PENDING;
+    UWU_PendingRequest request = pending->requests[idx];
+    if (request.kind != kind) {
+      continue;
+    }
+    if (request.key != key) {
+      return FALSE;
+    }
+
+    // Closes the gap, newer requests move one slot back.
+    for (size_t j = i + 1; j < pending->count; j++) {
+      size_t from = (pending->start + j) % MAX_PENDING;
+      size_t to = (pending->start + j - 1) % MAX_PENDING;
+      pending->requests[to] = pending->requests[from];
+    }
+    pending->count--;
+
+    uint64_t now = UWU_monotonicNs();
+    fio_atomic_add(&kind_stats[kind].answered, 1);
+    UWU_Histogram_record(&kind_stats[kind].latency,
+                         now > request.sent_at ? now - request.sent_at : 0);
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+// Like `pending_answer` for frames that always answer a request.
+void pending_answer_any(UWU_LoadPending *pending, UWU_LoadKind kind) {
+  if (!pending_answer(pending, kind, 0)) {
+    fio_atomic_add(&unknown_frames, 1);
+  }
+}
+
+/* *****************************************************************************
+WebSocket callbacks
+***************************************************************************** */
+
+// Returns the key that tells apart the answer to a SEND_MESSAGE request.
+uint64_t content_key(const char *content, size_t length) {
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (uint8_t)content[i];
+    hash *= 0x100000001b3ULL;
+  }
+  // 0 would match any frame.
+  return hash == 0 ? 1 : hash;
+}
+
+// Records the latency of a GOT_MESSAGE frame.
+//
+// Every connection receives the group messages and both ends of a DM receive
+// it. The sender records it as the response to its request and everyone else
+// records it as a delivery.
+// Takes the group messages when measuring the fan-out, returns `FALSE` when
+// it's not being measured.
+UWU_Bool fanout_receive(const char *content, size_t content_length,
+                        size_t frame_length);
+
+void on_got_message(UWU_LoadConn *conn, fio_str_info_s msg) {
+  // | type | origin length | origin | content length | content |
+  if (msg.len < 2 || msg.len < 3 + (uint8_t)msg.data[1]) {
+    fio_atomic_add(&unknown_frames, 1);
+    return;
+  }
+  uint8_t origin_length = msg.data[1];
+  UWU_Bool is_group = origin_length == 1 && msg.data[2] == '~';
+  char *content = &msg.data[3 + origin_length];
+  size_t content_length = msg.len - 3 - origin_length;
+  if (is_group && fanout_receive(content, content_length, msg.len)) {
+    return;
+  }
+
+  // Replayed messages don't carry a send time, they're matched by content.
+  if (content_length == 0 || content[0] != MESSAGE_MARKER) {
+    UWU_LoadKind kind = is_group ? LOAD_GROUP_MESSAGE : LOAD_DIRECT_MESSAGE;
+    pending_answer(&conn->pending, kind, content_key(content, content_length));
+    return;
+  }
+
+  char buffer[MIN_MESSAGE_SIZE + 1];
+  size_t length = content_length < MIN_MESSAGE_SIZE ? content_length
+                                                    : MIN_MESSAGE_SIZE;
+  memcpy(buffer, content, length);
+  buffer[length] = 0;
+
+  size_t sender_idx = 0;
+  unsigned long long sent_at = 0;
+  if (2 != sscanf(buffer, "#%zu:%llu", &sender_idx, &sent_at)) {
+    fio_atomic_add(&unknown_frames, 1);
+    return;
+  }
+  uint64_t now = UWU_monotonicNs();
+  uint64_t latency = now > sent_at ? now - sent_at : 0;
+
+  if (sender_idx != conn->idx) {
+    UWU_DeliveryKind kind = is_group ? DELIVERY_GROUP : DELIVERY_DIRECT;
+    UWU_Histogram_record(&delivery_latency[kind], latency);
+    return;
+  }
+
+  UWU_LoadKind kind = is_group ? LOAD_GROUP_MESSAGE : LOAD_DIRECT_MESSAGE;
+  fio_atomic_add(&kind_stats[kind].answered, 1);
+  UWU_Histogram_record(&kind_stats[kind].latency, latency);
+}
+
+void on_open(ws_s *ws) {
+  UWU_LoadConn *conn = websocket_udata_get(ws);
+
+  if (conn->is_churn) {
+    fio_lock(&conn->lock);
+    conn->ws = ws;
+    conn->is_leaving = TRUE;
+    conn->close_started_at = UWU_monotonicNs();
+    UWU_Histogram_record(&handshake_latency,
+                         conn->close_started_at - conn->connect_due_at);
+    websocket_close(ws);
+    fio_unlock(&conn->lock);
+
+    fio_atomic_add(&churn_stats.opened, 1);
+    return;
+  }
+
+  fio_lock(&conn->lock);
+  conn->ws = ws;
+  conn->status = ACTIVE;
+  fio_unlock(&conn->lock);
+
+  fio_atomic_add(&conn_stats.opened, 1);
+  fio_atomic_add(&conn_stats.open, 1);
+}
+
+void on_message(ws_s *ws, fio_str_info_s msg, uint8_t is_text) {
+  UWU_LoadConn *conn = websocket_udata_get(ws);
+  if (msg.len == 0) {
+    fio_atomic_add(&unknown_frames, 1);
+    return;
+  }
+
+  fio_lock(&conn->lock);
+  switch ((uint8_t)msg.data[0]) {
+  case ERROR: {
+    uint8_t code = msg.len > 1 ? msg.data[1] : 0;
+    if (code > USERNAME_TAKEN) {
+      fio_atomic_add(&unknown_frames, 1);
+      break;
+    }
+    fio_atomic_add(&error_counts[code], 1);
+
+    // The errors that answer a request of a known kind.
+    if (code == INVALID_STATUS) {
+      pending_answer_any(&conn->pending, LOAD_CHANGE_STATUS);
+    } else if (code == USER_NOT_FOUND) {
+      pending_answer(&conn->pending, LOAD_GET_USER, 0);
+    }
+  } break;
+  case LISTED_USERS:
+    pending_answer_any(&conn->pending, LOAD_LIST_USERS);
+    break;
+  case GOT_MESSAGES:
+    pending_answer_any(&conn->pending, LOAD_GET_MESSAGES);
+    break;
+  case GOT_USER:
+    pending_answer_any(&conn->pending, LOAD_GET_USER);
+    break;
+  case CHANGED_STATUS: {
+    // | type | username length | username | status |
+    UWU_Bool is_own = msg.len == 3 + (size_t)conn->name_length &&
+                      (uint8_t)msg.data[1] == conn->name_length &&
+                      0 == memcmp(&msg.data[2], conn->name, conn->name_length);
+    if (is_own) {
+      pending_answer_any(&conn->pending, LOAD_CHANGE_STATUS);
+    }
+  } break;
+  case GOT_MESSAGE:
+    on_got_message(conn, msg);
+    break;
+  case REGISTERED_USER:
+    break;
+  default:
+    fio_atomic_add(&unknown_frames, 1);
+    break;
+  }
+  fio_unlock(&conn->lock);
+}
+
+void on_close(intptr_t uuid, void *udata) {
+  UWU_LoadConn *conn = udata;
+
+  fio_lock(&conn->lock);
+  UWU_Bool was_open = conn->ws != NULL;
+  conn->ws = NULL;
+  if (conn->is_churn) {
+    if (was_open) {
+      UWU_Histogram_record(&close_latency,
+                           UWU_monotonicNs() - conn->close_started_at);
+      fio_atomic_add(&churn_stats.closed, 1);
+    } else {
+      fio_atomic_add(&churn_stats.failed, 1);
+    }
+    conn->pending.count = 0;
+    conn->is_busy = FALSE;
+    fio_unlock(&conn->lock);
+    return;
+  }
+  fio_unlock(&conn->lock);
+
+  if (!was_open) {
+    fio_atomic_add(&conn_stats.failed, 1);
+    return;
+  }
+
+  fio_atomic_sub(&conn_stats.open, 1);
+  if (!fio_is_running() || run_started_at == 0 || conn->is_leaving) {
+    return;
+  }
+  fio_atomic_add(&conn_stats.closed, 1);
+}
+
+// Splits `URL` into `URLS`, returns -1 if there are too many or one is empty.
+int split_urls(char *urls) {
+  URLS_COUNT = 0;
+  for (char *url = strtok(urls, ","); NULL != url; url = strtok(NULL, ",")) {
+    if (URLS_COUNT == MAX_URLS) {
+      return -1;
+    }
+    URLS[URLS_COUNT++] = url;
+  }
+  return URLS_COUNT == 0 ? -1 : 0;
+}
+
+// Starts the connection `conn`, returns -1 if it couldn't be started.
+int connect_one(UWU_LoadConn *conn) {
+  char url[1024];
+  int url_length =
+      snprintf(url, sizeof(url), "%s?name=%.*s", URLS[conn->idx % URLS_COUNT],
+               conn->name_length, conn->name);
+  if (url_length < 0 || (size_t)url_length >= sizeof(url)) {
+    fprintf(stderr, "Error: The URL is too long!\n");
+    return -1;
+  }
+
+  return websocket_connect(url, .on_open = on_open, .on_message = on_message,
+                           .on_close = on_close, .udata = conn);
+}
+
+/* *****************************************************************************
+Scheduler
+***************************************************************************** */
+
+// Picks a kind of request using the weights of the mix.
+UWU_LoadKind pick_kind() {
+  size_t roll = next_random() % TOTAL_WEIGHT;
+  for (size_t i = 0; i < LOAD_KINDS_COUNT; i++) {
+    if (roll < WEIGHTS[i]) {
+      return i;
+    }
+    roll -= WEIGHTS[i];
+  }
+  return LOAD_GROUP_MESSAGE;
+}
+
+// Picks an open connection other than `except`, NULL if there's none.
+//
+// Probing a few random slots keeps it cheap even with thousands of
+// connections, and it gives up quickly when almost none are open.
+UWU_LoadConn *pick_open_conn(UWU_LoadConn *except) {
+  for (size_t attempt = 0; attempt < 16; attempt++) {
+    UWU_LoadConn *conn = &conns[next_random() % CONNECTIONS];
+    if (conn != except && conn->ws != NULL) {
+      return conn;
+    }
+  }
+  return NULL;
+}
+
+// Writes the content of a message into `dest`: the marker, the index of the
+// sender and the scheduled send time, padded to `MESSAGE_SIZE`.
+size_t write_message_content(char *dest, UWU_LoadConn *conn,
+                             uint64_t sent_at) {
+  int length = snprintf(dest, MIN_MESSAGE_SIZE, "%c%zu:%llu", MESSAGE_MARKER,
+                        conn->idx, (unsigned long long)sent_at);
+  for (size_t i = length; i < MESSAGE_SIZE; i++) {
+    dest[i] = i == (size_t)length ? ';' : 'x';
+  }
+  return MESSAGE_SIZE;
+}
+
+// Sends a request of `kind` from `conn` that was due at `sent_at`.
+// Must be called while holding the lock of the connection.
+void send_request(UWU_LoadConn *conn, UWU_LoadKind kind, UWU_LoadConn *other,
+                  uint64_t sent_at) {
+  // | type | length | username | length | content |
+  char data[3 + 255 + MAX_MESSAGE_SIZE];
+  size_t data_length = 0;
+
+  switch (kind) {
+  case LOAD_GROUP_MESSAGE:
+    data[0] = SEND_MESSAGE;
+    data[1] = 1;
+    data[2] = '~';
+    data[3] = MESSAGE_SIZE;
+    data_length = 4 + write_message_content(&data[4], conn, sent_at);
+    break;
+  case LOAD_DIRECT_MESSAGE:
+    data[0] = SEND_MESSAGE;
+    data[1] = other->name_length;
+    memcpy(&data[2], other->name, other->name_length);
+    data[2 + other->name_length] = MESSAGE_SIZE;
+    data_length = 3 + other->name_length;
+    data_length +=
+        write_message_content(&data[data_length], conn, sent_at);
+    break;
+  case LOAD_GET_MESSAGES:
+    // Half of them ask for the group chat and half for a DM.
+    data[0] = GET_MESSAGES;
+    if (other == NULL || next_random() % 2 == 0) {
+      data[1] = 1;
+      data[2] = '~';
+      data_length = 3;
+    } else {
+      data[1] = other->name_length;
+      memcpy(&data[2], other->name, other->name_length);
+      data_length = 2 + other->name_length;
+    }
+    pending_push(&conn->pending, kind, sent_at, 0);
+    break;
+  case LOAD_LIST_USERS:
+    data[0] = LIST_USERS;
+    data_length = 1;
+    pending_push(&conn->pending, kind, sent_at, 0);
+    break;
+  case LOAD_CHANGE_STATUS:
+    conn->status = conn->status == BUSY ? ACTIVE : BUSY;
+    data[0] = CHANGE_STATUS;
+    data[1] = conn->name_length;
+    memcpy(&data[2], conn->name, conn->name_length);
+    data[2 + conn->name_length] = conn->status;
+    data_length = 3 + conn->name_length;
+    pending_push(&conn->pending, kind, sent_at, 0);
+    break;
+  case LOAD_GET_USER:
+    data[0] = GET_USER;
+    data[1] = other->name_length;
+    memcpy(&data[2], other->name, other->name_length);
+    data_length = 2 + other->name_length;
+    pending_push(&conn->pending, kind, sent_at, 0);
+    break;
+  default:
+    return;
+  }
+
+  fio_str_info_s msg = {.data = data, .len = data_length};
+  if (-1 == websocket_write(conn->ws, msg, 0)) {
+    fprintf(stderr, "Error: Failed to send a `%s` request!\n",
+            LOAD_KIND_NAMES[kind]);
+    return;
+  }
+  fio_atomic_add(&kind_stats[kind].sent, 1);
+}
+
+// Sends one request of a random kind from a random open connection.
+// `scheduled_at` is the time the request should have been sent at.
+void schedule_request(uint64_t scheduled_at) {
+  UWU_LoadKind kind = pick_kind();
+  UWU_LoadConn *conn = pick_open_conn(NULL);
+  if (NULL == conn) {
+    fio_atomic_add(&skipped_requests, 1);
+    return;
+  }
+
+  UWU_LoadConn *other = NULL;
+  if (kind == LOAD_DIRECT_MESSAGE || kind == LOAD_GET_MESSAGES ||
+      kind == LOAD_GET_USER) {
+    other = pick_open_conn(conn);
+    if (NULL == other && kind != LOAD_GET_MESSAGES) {
+      fio_atomic_add(&skipped_requests, 1);
+      return;
+    }
+  }
+
+  fio_lock(&conn->lock);
+  if (conn->ws != NULL) {
+    send_request(conn, kind, other, scheduled_at);
+  } else {
+    fio_atomic_add(&skipped_requests, 1);
+  }
+  fio_unlock(&conn->lock);
+}
+
+// Opens a churn connection that was due at `scheduled_at`, as a new user.
+void schedule_churn(uint64_t scheduled_at) {
+  UWU_LoadConn *conn = NULL;
+  for (size_t i = 0; i < churn_slots && NULL == conn; i++) {
+    UWU_LoadConn *slot = &churn_conns[(churns_scheduled + i) % churn_slots];
+    fio_lock(&slot->lock);
+    if (!slot->is_busy) {
+      slot->is_busy = TRUE;
+      conn = slot;
+    }
+    fio_unlock(&slot->lock);
+  }
+  if (NULL == conn) {
+    fio_atomic_add(&churn_stats.skipped, 1);
+    return;
+  }
+
+  // Every churn joins with a username the server hasn't seen yet.
+  int length = snprintf(conn->name, sizeof(conn->name), "%.16s%d-churn%zu",
+                        fio_cli_get("-name"), (int)getpid(), churns_scheduled);
+  conn->name_length = length;
+  conn->is_leaving = FALSE;
+  conn->connect_due_at = scheduled_at;
+  fio_atomic_add(&churn_stats.started, 1);
+
+  if (-1 == connect_one(conn)) {
+    fio_atomic_add(&churn_stats.failed, 1);
+    fio_lock(&conn->lock);
+    conn->is_busy = FALSE;
+    fio_unlock(&conn->lock);
+  }
+}
+
+// Prints a line with the progress of the run every second.
+void print_progress(uint64_t now) {
+  size_t second = (now - run_started_at) / 1000000000;
+  if (second == last_progress_second) {
+    return;
+  }
+
+  size_t answered = total_answered();
+  size_t errors = 0;
+  for (size_t i = 0; i <= USERNAME_TAKEN; i++) {
+    errors += fio_atomic_add(&error_counts[i], 0);
+  }
+  fprintf(stderr, "Info: %zus open=%zu answered/s=%zu errors=%zu\n", second,
+          fio_atomic_add(&conn_stats.open, 0),
+          (answered - last_progress_answered) /
+              (second - last_progress_second),
+          errors);
+
+  last_progress_second = second;
+  last_progress_answered = answered;
+}
+
+// Opens the connections at `CONNECT_RATE` and, once they're all open, sends the
+// requests that are due at `RATE` until the run is over.
+void tick(void *arg) {
+  if (fio_trylock(&tick_lock)) {
+    return;
+  }
+  uint64_t now = UWU_monotonicNs();
+
+  if (run_started_at == 0) {
+    size_t due = CONNECTIONS;
+    if (CONNECT_RATE > 0) {
+      due = (now - ramp_started_at) * CONNECT_RATE / 1000000000 + 1;
+      due = due < CONNECTIONS ? due : CONNECTIONS;
+    }
+    for (; connects_started < due; connects_started++) {
+      if (-1 == connect_one(&conns[connects_started])) {
+        fio_atomic_add(&conn_stats.failed, 1);
+      }
+    }
+
+    size_t settled = fio_atomic_add(&conn_stats.opened, 0) +
+                     fio_atomic_add(&conn_stats.failed, 0);
+    if (settled >= CONNECTIONS) {
+      fprintf(stderr, "Info: %zu connections open, %zu failed. Running...\n",
+              conn_stats.opened, conn_stats.failed);
+      run_started_at = now;
+      last_progress_answered = total_answered();
+    }
+    fio_unlock(&tick_lock);
+    return;
+  }
+
+  uint64_t elapsed = now - run_started_at;
+  if (elapsed >= DURATION_SECONDS * 1000000000) {
+    fio_stop();
+    fio_unlock(&tick_lock);
+    return;
+  }
+
+  // A late tick sends everything it missed, with the times they were due at.
+  size_t due = (size_t)((double)elapsed * RATE / 1e9);
+  for (; requests_scheduled < due; requests_scheduled++) {
+    uint64_t offset = (uint64_t)((requests_scheduled + 1) * 1e9 / RATE);
+    schedule_request(run_started_at + offset);
+  }
+
+  size_t churns_due = (size_t)((double)elapsed * CHURN_RATE / 1e9);
+  for (; churns_scheduled < churns_due; churns_scheduled++) {
+    uint64_t offset = (uint64_t)((churns_scheduled + 1) * 1e9 / CHURN_RATE);
+    schedule_churn(run_started_at + offset);
+  }
+
+  print_progress(now);
+  fio_unlock(&tick_lock);
+}
+
+/* *****************************************************************************
+Replay
+***************************************************************************** */
+
+// How long to wait for the last answers once every record was replayed.
+const uint64_t REPLAY_DRAIN_NS = 2000000000;
+// Captures with more connections than this are considered corrupted.
+const uint64_t REPLAY_MAX_CONNECTIONS = 1 << 24;
+
+// A record of the capture file being replayed.
+typedef struct {
+  // When it happened, in nanoseconds since the first record.
+  uint64_t at;
+  UWU_CaptureRecord type;
+  UWU_LoadConn *conn;
+  // The frame of FRAME records, points inside `replay_file`.
+  char *data;
+  size_t length;
+} UWU_ReplayEvent;
+
+// The capture file to replay, NULL runs the synthetic load instead.
+// Configured with `-replay`.
+static const char *REPLAY_PATH = NULL;
+// Configured with `-speed`, 2 replays the capture twice as fast.
+static double REPLAY_SPEED = 1;
+
+static char *replay_file = NULL;
+static UWU_ReplayEvent *replay_events = NULL;
+static size_t replay_events_count = 0;
+static size_t replay_next = 0;
+// Replayed frames that don't get an answer to measure, like WATCH_USERS.
+static size_t replay_unmeasured = 0;
+
+// Parses the records of the capture, `replay_events` must have space for all
+// of them unless it's NULL. Returns the amount of records, -1 if the capture
+// is invalid. `max_id` is set to the biggest connection id.
+ssize_t parse_replay(size_t length, uint64_t *max_id) {
+  const uint8_t *data = (const uint8_t *)replay_file;
+  size_t offset = sizeof(UWU_CAPTURE_MAGIC);
+  size_t count = 0;
+  uint64_t at = 0;
+  *max_id = 0;
+
+  while (offset < length) {
+    uint8_t type = data[offset++];
+    uint64_t id = 0;
+    uint64_t delta = 0;
+    uint64_t record_length = 0;
+    if (!UWU_Varint_read(data, length, &offset, &id) ||
+        !UWU_Varint_read(data, length, &offset, &delta)) {
+      return -1;
+    }
+    if (type != CAPTURE_CLOSE &&
+        !UWU_Varint_read(data, length, &offset, &record_length)) {
+      return -1;
+    }
+
+    UWU_Bool is_valid_type = type >= CAPTURE_OPEN && type <= CAPTURE_CLOSE;
+    UWU_Bool is_valid_open = type != CAPTURE_OPEN || record_length <= 255;
+    if (!is_valid_type || !is_valid_open || id == 0 ||
+        id > REPLAY_MAX_CONNECTIONS || record_length > length - offset) {
+      return -1;
+    }
+
+    // The capture starts when the server does, the replay on the first record.
+    at = count == 0 ? 0 : at + delta * 1000;
+    *max_id = id > *max_id ? id : *max_id;
+
+    if (NULL != replay_events) {
+      UWU_ReplayEvent event = {
+          .at = at,
+          .type = type,
+          .conn = &conns[id - 1],
+          .data = &replay_file[offset],
+          .length = record_length,
+      };
+      replay_events[count] = event;
+    }
+
+    offset += record_length;
+    count++;
+  }
+
+  return count;
+}
+
+// Reads the capture file at `REPLAY_PATH` into `replay_events` and creates a
+// connection for every connection captured, with the same username.
+// Returns -1 if it can't be read or it's not a valid capture.
+int load_replay() {
+  FILE *file = fopen(REPLAY_PATH, "rb");
+  if (NULL == file) {
+    fprintf(stderr, "Error: Can't open capture `%s`: %s\n", REPLAY_PATH,
+            strerror(errno));
+    return -1;
+  }
+
+  struct stat info;
+  if (0 != fstat(fileno(file), &info) ||
+      info.st_size < (off_t)sizeof(UWU_CAPTURE_MAGIC)) {
+    fprintf(stderr, "Error: `%s` is not a capture!\n", REPLAY_PATH);
+    fclose(file);
+    return -1;
+  }
+  size_t length = info.st_size;
+
+  replay_file = UWU_malloc(UWU_ALLOC_RESPONSES, length);
+  if (NULL == replay_file || 1 != fread(replay_file, length, 1, file)) {
+    fprintf(stderr, "Error: Can't read capture `%s`!\n", REPLAY_PATH);
+    fclose(file);
+    return -1;
+  }
+  fclose(file);
+
+  uint64_t max_id = 0;
+  ssize_t count = -1;
+  if (0 == memcmp(replay_file, UWU_CAPTURE_MAGIC, sizeof(UWU_CAPTURE_MAGIC))) {
+    count = parse_replay(length, &max_id);
+  }
+  if (count < 0 || max_id == 0) {
+    fprintf(stderr, "Error: `%s` is not a valid capture!\n", REPLAY_PATH);
+    return -1;
+  }
+
+  CONNECTIONS = max_id;
+  conns = UWU_calloc(UWU_ALLOC_USERS, CONNECTIONS, sizeof(UWU_LoadConn));
+  replay_events =
+      UWU_calloc(UWU_ALLOC_RESPONSES, count, sizeof(UWU_ReplayEvent));
+  if (NULL == conns || NULL == replay_events) {
+    fprintf(stderr, "Error: Failed to allocate the replay!\n");
+    return -1;
+  }
+  replay_events_count = parse_replay(length, &max_id);
+
+  for (size_t i = 0; i < CONNECTIONS; i++) {
+    conns[i].idx = i;
+  }
+  for (size_t i = 0; i < replay_events_count; i++) {
+    UWU_ReplayEvent *event = &replay_events[i];
+    if (event->type == CAPTURE_OPEN) {
+      memcpy(event->conn->name, event->data, event->length);
+      event->conn->name_length = event->length;
+    }
+  }
+
+  return 0;
+}
+
+// Sends a captured frame from `conn`, waiting for its answer if it has one.
+// Must be called while holding the lock of the connection.
+void replay_frame(UWU_LoadConn *conn, UWU_ReplayEvent *event,
+                  uint64_t scheduled_at) {
+  char *data = event->data;
+  size_t length = event->length;
+  UWU_Bool is_measured = length > 0;
+  UWU_LoadKind kind = LOAD_KINDS_COUNT;
+  uint64_t key = 0;
+
+  switch (length > 0 ? (uint8_t)data[0] : 0) {
+  case SEND_MESSAGE: {
+    // | type | length | username | length | content |
+    if (length < 3 || length < 3 + (uint8_t)data[1]) {
+      is_measured = FALSE;
+      break;
+    }
+    uint8_t username_length = data[1];
+    UWU_Bool is_group = username_length == 1 && data[2] == '~';
+    size_t content_length = length - 3 - username_length;
+    if ((uint8_t)data[2 + username_length] < content_length) {
+      content_length = (uint8_t)data[2 + username_length];
+    }
+
+    kind = is_group ? LOAD_GROUP_MESSAGE : LOAD_DIRECT_MESSAGE;
+    key = content_key(&data[3 + username_length], content_length);
+  } break;
+  case GET_MESSAGES:
+    kind = LOAD_GET_MESSAGES;
+    break;
+  case LIST_USERS:
+    kind = LOAD_LIST_USERS;
+    break;
+  case CHANGE_STATUS:
+    kind = LOAD_CHANGE_STATUS;
+    break;
+  case GET_USER:
+    kind = LOAD_GET_USER;
+    break;
+  default:
+    is_measured = FALSE;
+    break;
+  }
+
+  fio_str_info_s msg = {.data = data, .len = length};
+  if (-1 == websocket_write(conn->ws, msg, 0)) {
+    fprintf(stderr, "Error: Failed to replay a frame!\n");
+    return;
+  }
+
+  if (!is_measured) {
+    fio_atomic_add(&replay_unmeasured, 1);
+    return;
+  }
+  pending_push(&conn->pending, kind, scheduled_at, key);
+  fio_atomic_add(&kind_stats[kind].sent, 1);
+}
+
+// Replays a single record that was due at `scheduled_at`.
+void replay_event(UWU_ReplayEvent *event, uint64_t scheduled_at) {
+  UWU_LoadConn *conn = event->conn;
+
+  if (event->type == CAPTURE_OPEN) {
+    if (-1 == connect_one(conn)) {
+      fio_atomic_add(&conn_stats.failed, 1);
+    }
+    return;
+  }
+
+  fio_lock(&conn->lock);
+  if (NULL == conn->ws) {
+    if (event->type == CAPTURE_FRAME) {
+      fio_atomic_add(&skipped_requests, 1);
+    }
+  } else if (event->type == CAPTURE_FRAME) {
+    replay_frame(conn, event, scheduled_at);
+  } else {
+    conn->is_leaving = TRUE;
+    websocket_close(conn->ws);
+  }
+  fio_unlock(&conn->lock);
+}
+
+// Replays the records that are due at `REPLAY_SPEED`, and stops once the last
+// one had time to be answered.
+void replay_tick(void *arg) {
+  if (fio_trylock(&tick_lock)) {
+    return;
+  }
+  uint64_t now = UWU_monotonicNs();
+  if (run_started_at == 0) {
+    run_started_at = now;
+  }
+
+  uint64_t elapsed = (uint64_t)((now - run_started_at) * REPLAY_SPEED);
+  for (; replay_next < replay_events_count &&
+         replay_events[replay_next].at <= elapsed;
+       replay_next++) {
+    UWU_ReplayEvent *event = &replay_events[replay_next];
+    replay_event(event, run_started_at + event->at / REPLAY_SPEED);
+  }
+
+  if (replay_next == replay_events_count) {
+    UWU_ReplayEvent *last = &replay_events[replay_events_count - 1];
+    uint64_t last_at = run_started_at + last->at / REPLAY_SPEED;
+    if (now > last_at && now - last_at >= REPLAY_DRAIN_NS) {
+      fio_stop();
+    }
+  }
+
+  print_progress(now);
+  fio_unlock(&tick_lock);
+}
+
+/* *****************************************************************************
+Scale
+***************************************************************************** */
+
+// How many plateaus `-idle` and `-fanout` can list.
+#define MAX_PLATEAUS 16
+// The biggest `/metrics` response that can be read.
+#define METRICS_RESPONSE_SIZE (1 << 18)
+// How long a scrape can wait on the server to connect, send or answer.
+#define METRICS_TIMEOUT_SECONDS 5
+
+// What the server reported on `/metrics`, in bytes and seconds.
+typedef struct {
+  double connections;
+  double rss;
+  // The user list.
+  double registry;
+  // DM histories, the group history and the table that indexes them.
+  double chats;
+  double sessions;
+  // RSS not tracked by the server allocator, mostly facil.io state.
+  double untracked;
+  double idle_cpu;
+  double idle_scan;
+  // CPU used by the whole server process.
+  double cpu;
+  // Live bytes and allocations of the server allocator, across subsystems.
+  double allocated;
+  double allocations;
+  // 1 if the server runs a single worker, see `is_single_worker`.
+  double single_worker;
+} UWU_ServerSample;
+
+// The amounts of connections to measure at, configured with `-idle` or
+// `-fanout`.
+static size_t PLATEAUS[MAX_PLATEAUS] = {};
+static size_t PLATEAUS_COUNT = 0;
+// How long to wait on every plateau before measuring it.
+// Configured with `-settle`.
+static size_t SETTLE_SECONDS = 0;
+
+static size_t current_plateau = 0;
+static uint64_t plateau_started_at = 0;
+static size_t plateau_first_connect = 0;
+// Zero while the connections of the plateau are still being opened.
+static uint64_t plateau_reached_at = 0;
+static UWU_ServerSample idle_baseline = {};
+static UWU_ServerSample plateau_start = {};
+static UWU_ServerSample plateau_end = {};
+// `TRUE` once `plateau_start` was scraped for the current plateau.
+static UWU_Bool is_plateau_started = FALSE;
+static char metrics_response[METRICS_RESPONSE_SIZE];
+
+// The scrapes started by `scrape_async`.
+typedef enum {
+  SCRAPE_NONE,
+  SCRAPE_RUNNING,
+  SCRAPE_DONE,
+  SCRAPE_FAILED,
+} UWU_ScrapeState;
+
+static UWU_ScrapeState scrape_state = SCRAPE_NONE;
+static UWU_ServerSample scrape_result = {};
+
+// Returns the value of the metric `name`, with its labels, 0 if it's missing.
+double metric_value(const char *body, const char *name) {
+  size_t name_length = strlen(name);
+  for (const char *line = body; NULL != line; line = strchr(line, '\n')) {
+    line += *line == '\n' ? 1 : 0;
+    if (0 == strncmp(line, name, name_length) && line[name_length] == ' ') {
+      return strtod(&line[name_length + 1], NULL);
+    }
+  }
+  return 0;
+}
+
+// Reads `/metrics` from the server of the first URL, blocking until it's done
+// or `METRICS_TIMEOUT_SECONDS` pass without progress.
+// Returns -1 if the server couldn't be scraped.
+int scrape_metrics(UWU_ServerSample *sample) {
+  fio_url_s url = fio_url_parse(URLS[0], strlen(URLS[0]));
+  char host[256];
+  char port[16];
+  snprintf(host, sizeof(host), "%.*s", (int)url.host.len, url.host.data);
+  snprintf(port, sizeof(port), "%.*s", (int)url.port.len, url.port.data);
+
+  struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+  struct addrinfo *info = NULL;
+  if (0 != getaddrinfo(host, url.port.len > 0 ? port : "80", &hints, &info)) {
+    fprintf(stderr, "Error: Can't resolve `%s`!\n", host);
+    return -1;
+  }
+  int fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+  struct timeval timeout = {.tv_sec = METRICS_TIMEOUT_SECONDS};
+  if (-1 != fd) {
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  }
+  if (-1 == fd || 0 != connect(fd, info->ai_addr, info->ai_addrlen)) {
+    fprintf(stderr, "Error: Can't connect to `%s`: %s\n", host,
+            strerror(errno));
+    freeaddrinfo(info);
+    if (-1 != fd) {
+      close(fd);
+    }
+    return -1;
+  }
+  freeaddrinfo(info);
+
+  char request[512];
+  int request_length = snprintf(request, sizeof(request),
+                                "GET /metrics HTTP/1.0\r\nHost: %s\r\n"
+                                "Connection: close\r\n\r\n",
+                                host);
+  size_t length = 0;
+  if (request_length == write(fd, request, request_length)) {
+    ssize_t got = 0;
+    while (length < sizeof(metrics_response) - 1 &&
+           0 < (got = read(fd, &metrics_response[length],
+                           sizeof(metrics_response) - 1 - length))) {
+      length += got;
+    }
+  }
+  close(fd);
+  metrics_response[length] = '\0';
+
+  const char *body = strstr(metrics_response, "\r\n\r\n");
+  if (NULL == body || NULL == strstr(body, "uwuchat_connections ")) {
+    fprintf(stderr, "Error: `/metrics` didn't answer with the metrics!\n");
+    return -1;
+  }
+
+  sample->connections = metric_value(body, "uwuchat_connections");
+  sample->rss = metric_value(body, "uwuchat_memory_bytes{area=\"rss\"}");
+  sample->registry =
+      metric_value(body, "uwuchat_memory_bytes{area=\"user_list\"}");
+  sample->chats =
+      metric_value(body, "uwuchat_memory_bytes{area=\"dm_histories\"}") +
+      metric_value(body, "uwuchat_memory_bytes{area=\"group_history\"}") +
+      metric_value(body, "uwuchat_memory_bytes{area=\"chats_index\"}");
+  sample->sessions =
+      metric_value(body, "uwuchat_memory_bytes{area=\"sessions\"}");
+  sample->untracked =
+      metric_value(body, "uwuchat_memory_bytes{area=\"untracked\"}");
+  sample->idle_cpu =
+      metric_value(body, "uwuchat_idle_detector_cpu_seconds_total");
+  sample->idle_scan = metric_value(body, "uwuchat_idle_detector_scan_seconds");
+  sample->cpu = metric_value(body, "uwuchat_cpu_seconds_total");
+  sample->single_worker = metric_value(body, "uwuchat_single_worker");
+
+  sample->allocated = 0;
+  sample->allocations = 0;
+  for (size_t i = 0; i < UWU_ALLOC_SUBSYSTEMS_COUNT; i++) {
+    char name[128];
+    snprintf(name, sizeof(name), "uwuchat_allocated_bytes{subsystem=\"%s\"}",
+             UWU_ALLOC_SUBSYSTEM_NAMES[i]);
+    sample->allocated += metric_value(body, name);
+    snprintf(name, sizeof(name), "uwuchat_allocations{subsystem=\"%s\"}",
+             UWU_ALLOC_SUBSYSTEM_NAMES[i]);
+    sample->allocations += metric_value(body, name);
+  }
+  return 0;
+}
+
+// Every scrape reaches a single worker of the server, so the memory and CPU it
+// reports are only the ones of the whole server if it runs with `-w 1`.
+// Returns `FALSE` and explains it if that's not the case.
+UWU_Bool is_single_worker(UWU_ServerSample *sample) {
+  if (sample->single_worker == 1) {
+    return TRUE;
+  }
+
+  fprintf(stderr, "Error: The server runs more than one worker, its "
+                  "metrics would be of a single one. Run it with -w 1!\n");
+  return FALSE;
+}
+
+// Runs a scrape started by `scrape_async`.
+static void *scrape_worker(void *arg) {
+  UWU_ScrapeState state =
+      0 == scrape_metrics(&scrape_result) ? SCRAPE_DONE : SCRAPE_FAILED;
+  __atomic_store_n(&scrape_state, state, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+// Scrapes the server on a helper thread, so the ticks never block a reactor
+// thread on it. Only one scrape runs at a time.
+//
+// The first call starts the scrape and the next ones check on it. Returns 1
+// while it's running, 0 once `sample` holds the result and -1 if it failed.
+int scrape_async(UWU_ServerSample *sample) {
+  UWU_ScrapeState state = __atomic_load_n(&scrape_state, __ATOMIC_ACQUIRE);
+  switch (state) {
+  case SCRAPE_NONE: {
+    scrape_state = SCRAPE_RUNNING;
+    pthread_t scraper;
+    if (0 != pthread_create(&scraper, NULL, scrape_worker, NULL)) {
+      fprintf(stderr, "Error: Can't create the scraper thread!\n");
+      scrape_state = SCRAPE_NONE;
+      return -1;
+    }
+    pthread_detach(scraper);
+    return 1;
+  }
+  case SCRAPE_RUNNING:
+    return 1;
+  case SCRAPE_DONE:
+    *sample = scrape_result;
+    scrape_state = SCRAPE_NONE;
+    return 0;
+  case SCRAPE_FAILED:
+    scrape_state = SCRAPE_NONE;
+    return -1;
+  }
+  return -1;
+}
+
+// Parses a comma separated list of growing amounts into `amounts`, returns
+// their count or -1 if it's not valid.
+int read_amounts(const char *list, size_t *amounts, size_t max_count) {
+  size_t count = 0;
+  size_t last = 0;
+  while (*list != '\0') {
+    char *end = NULL;
+    long amount = strtol(list, &end, 10);
+    if (end == list || amount <= (long)last || count == max_count) {
+      return -1;
+    }
+    amounts[count++] = amount;
+    last = amount;
+    list = *end == ',' ? end + 1 : end;
+    if (*end != ',' && *end != '\0') {
+      return -1;
+    }
+  }
+  return count == 0 ? -1 : (int)count;
+}
+
+// Prints how the server grew from the baseline to `sample`, per connection.
+void print_plateau(UWU_ServerSample *sample, double seconds) {
+  double connections = sample->connections - idle_baseline.connections;
+  double per = connections > 0 ? 1 / connections : 0;
+
+  printf("%11.0f %10.1f %10.0f %13.0f %10.0f %13.0f %10.0f %14.3f %9.3f\n",
+         sample->connections, sample->rss / (1 << 20),
+         (sample->rss - idle_baseline.rss) * per,
+         (sample->registry - idle_baseline.registry) * per,
+         (sample->chats - idle_baseline.chats) * per,
+         (sample->sessions - idle_baseline.sessions) * per,
+         (sample->untracked - idle_baseline.untracked) * per,
+         (sample->idle_cpu - plateau_start.idle_cpu) * 1e3 / seconds,
+         sample->idle_scan * 1e3);
+  fflush(stdout);
+}
+
+// Opens the connections of the current plateau at `CONNECT_RATE`, returns
+// `TRUE` once all of them are open or failed.
+UWU_Bool ramp_plateau(uint64_t now) {
+  size_t target = PLATEAUS[current_plateau];
+  size_t due = target;
+  if (CONNECT_RATE > 0) {
+    due = plateau_first_connect +
+          (now - plateau_started_at) * CONNECT_RATE / 1000000000 + 1;
+    due = due < target ? due : target;
+  }
+  for (; connects_started < due; connects_started++) {
+    if (-1 == connect_one(&conns[connects_started])) {
+      fio_atomic_add(&conn_stats.failed, 1);
+    }
+  }
+
+  size_t settled = fio_atomic_add(&conn_stats.opened, 0) +
+                   fio_atomic_add(&conn_stats.failed, 0);
+  if (settled < target) {
+    return FALSE;
+  }
+  fprintf(stderr, "Info: %zu connections open, %zu failed. Settling...\n",
+          conn_stats.opened, conn_stats.failed);
+  return TRUE;
+}
+
+// Moves to the next plateau, stopping after the last one.
+void next_plateau(uint64_t now) {
+  current_plateau++;
+  if (current_plateau == PLATEAUS_COUNT) {
+    fio_stop();
+  }
+  plateau_reached_at = 0;
+  is_plateau_started = FALSE;
+  plateau_started_at = now;
+  plateau_first_connect = connects_started;
+}
+
+// Opens the connections of every plateau, and once they're open and had
+// `SETTLE_SECONDS` to settle, measures the server.
+void idle_tick(void *arg) {
+  if (fio_trylock(&tick_lock)) {
+    return;
+  }
+  uint64_t now = UWU_monotonicNs();
+
+  if (run_started_at == 0) {
+    int scraped = scrape_async(&idle_baseline);
+    if (0 != scraped) {
+      if (-1 == scraped) {
+        fio_stop();
+      }
+      fio_unlock(&tick_lock);
+      return;
+    }
+    if (!is_single_worker(&idle_baseline)) {
+      fio_stop();
+      fio_unlock(&tick_lock);
+      return;
+    }
+    printf("%11s %10s %10s %13s %10s %13s %10s %14s %9s\n", "connections",
+           "rss(MiB)", "bytes/conn", "registry/conn", "chats/conn",
+           "sessions/conn", "facil/conn", "idle_cpu(ms/s)", "scan(ms)");
+    run_started_at = now;
+    plateau_started_at = now;
+  }
+
+  if (plateau_reached_at == 0) {
+    if (ramp_plateau(now)) {
+      plateau_reached_at = UWU_monotonicNs();
+    }
+  } else if (!is_plateau_started) {
+    int scraped = scrape_async(&plateau_start);
+    if (-1 == scraped) {
+      fio_stop();
+    }
+    is_plateau_started = 0 == scraped;
+  } else if (now - plateau_reached_at >= SETTLE_SECONDS * 1000000000) {
+    int scraped = scrape_async(&plateau_end);
+    if (0 == scraped) {
+      print_plateau(&plateau_end, (now - plateau_reached_at) / 1e9);
+    }
+    if (1 != scraped) {
+      next_plateau(now);
+    }
+  }
+
+  print_progress(now);
+  fio_unlock(&tick_lock);
+}
+
+/* *****************************************************************************
+Fan-out
+***************************************************************************** */
+
+// How many sizes `-fanout-sizes` can list.
+#define MAX_FANOUT_SIZES 16
+// How long to wait for every subscriber to get a group message before sending
+// the next one.
+const uint64_t FANOUT_TIMEOUT_NS = 5000000000;
+
+typedef struct {
+  // Group messages sent.
+  size_t messages;
+  // Messages that didn't reach every subscriber before `FANOUT_TIMEOUT_NS`.
+  size_t incomplete;
+  // Copies of the messages received, and the bytes of their frames.
+  size_t deliveries;
+  size_t bytes;
+  // Copies of a message received after it timed out.
+  size_t late;
+  // From the time a message was sent to the time its last subscriber got it.
+  UWU_Histogram last_delivery;
+  // The time spent waiting for messages to be delivered.
+  uint64_t busy_ns;
+} UWU_FanoutStats;
+
+// The message sizes to measure on every plateau.
+// Configured with `-fanout-sizes`.
+static size_t FANOUT_SIZES[MAX_FANOUT_SIZES] = {};
+static size_t FANOUT_SIZES_COUNT = 0;
+// Messages sent for every size. Configured with `-fanout-messages`.
+static size_t FANOUT_MESSAGES = 0;
+
+static size_t fanout_size = 0;
+static size_t fanout_sent = 0;
+static UWU_ServerSample fanout_start = {};
+static UWU_ServerSample fanout_end = {};
+// Guards the message being delivered and `fanout_stats`.
+static fio_lock_i fanout_lock = FIO_LOCK_INIT;
+// The first byte of the message being delivered, to tell it from late copies
+// of older ones.
+static uint8_t fanout_tag = 0;
+// Zero while no message is being delivered.
+static uint64_t fanout_sent_at = 0;
+static size_t fanout_expected = 0;
+static size_t fanout_received = 0;
+static uint64_t fanout_last_at = 0;
+static UWU_FanoutStats fanout_stats = {};
+
+UWU_Bool fanout_receive(const char *content, size_t content_length,
+                        size_t frame_length) {
+  if (FANOUT_SIZES_COUNT == 0) {
+    return FALSE;
+  }
+  uint64_t now = UWU_monotonicNs();
+
+  fio_lock(&fanout_lock);
+  fanout_stats.deliveries++;
+  fanout_stats.bytes += frame_length;
+  if (fanout_sent_at != 0 && content_length > 0 &&
+      (uint8_t)content[0] == fanout_tag) {
+    fanout_received++;
+    fanout_last_at = now;
+  } else {
+    fanout_stats.late++;
+  }
+  fio_unlock(&fanout_lock);
+  return TRUE;
+}
+
+// Sends a group message of the current size from the first connection, every
+// open connection is subscribed so all of them should get it.
+void fanout_send() {
+  size_t size = FANOUT_SIZES[fanout_size];
+  uint8_t tag = '!' + fanout_stats.messages % 94;
+
+  // | type | length | username | length | content |
+  char data[4 + MAX_MESSAGE_SIZE];
+  data[0] = SEND_MESSAGE;
+  data[1] = 1;
+  data[2] = '~';
+  data[3] = size;
+  data[4] = tag;
+  memset(&data[5], 'x', size - 1);
+  fio_str_info_s msg = {.data = data, .len = 4 + size};
+
+  fio_lock(&fanout_lock);
+  fanout_tag = tag;
+  fanout_expected = fio_atomic_add(&conn_stats.open, 0);
+  fanout_received = 0;
+  fanout_sent_at = UWU_monotonicNs();
+  fanout_stats.messages++;
+  fio_unlock(&fanout_lock);
+
+  UWU_LoadConn *conn = &conns[0];
+  fio_lock(&conn->lock);
+  int result = NULL != conn->ws ? websocket_write(conn->ws, msg, 0) : -1;
+  fio_unlock(&conn->lock);
+  fanout_sent++;
+
+  if (-1 == result) {
+    fprintf(stderr, "Error: Failed to send a group message!\n");
+    fio_lock(&fanout_lock);
+    fanout_sent_at = 0;
+    fanout_stats.incomplete++;
+    fio_unlock(&fanout_lock);
+  }
+}
+
+// Prints what it cost the server to deliver the messages of the current size.
+void print_fanout(UWU_ServerSample *sample) {
+  UWU_FanoutStats *stats = &fanout_stats;
+  UWU_Histogram *hist = &stats->last_delivery;
+  double busy_seconds = stats->busy_ns > 0 ? stats->busy_ns / 1e9 : 1;
+  double cpu = (sample->cpu - fanout_start.cpu) / stats->messages;
+
+  printf("%11.0f %5zu %8zu %10zu %10.1f %10.1f %10.1f %15.1f %12.2f %12.0f\n",
+         sample->connections, FANOUT_SIZES[fanout_size], stats->messages,
+         stats->incomplete, UWU_Histogram_percentile(hist, 50) / 1e3,
+         UWU_Histogram_percentile(hist, 99) / 1e3, hist->max / 1e3, cpu * 1e6,
+         stats->bytes / busy_seconds / (1 << 20),
+         stats->deliveries / busy_seconds);
+  fflush(stdout);
+}
+
+// Sends the messages of every size one at a time, waiting for each one to be
+// delivered. Returns `TRUE` once every size was measured.
+UWU_Bool fanout_step(uint64_t now) {
+  if (fanout_sent == 0 && fanout_sent_at == 0) {
+    int scraped = scrape_async(&fanout_start);
+    if (0 != scraped || !is_single_worker(&fanout_start)) {
+      if (1 != scraped) {
+        fio_stop();
+      }
+      return FALSE;
+    }
+    fio_lock(&fanout_lock);
+    fanout_stats = (UWU_FanoutStats){};
+    fio_unlock(&fanout_lock);
+  }
+
+  fio_lock(&fanout_lock);
+  UWU_Bool is_waiting = fanout_sent_at != 0;
+  if (is_waiting && fanout_received >= fanout_expected) {
+    UWU_Histogram_record(&fanout_stats.last_delivery,
+                         fanout_last_at - fanout_sent_at);
+    fanout_stats.busy_ns += fanout_last_at - fanout_sent_at;
+    fanout_sent_at = 0;
+    is_waiting = FALSE;
+  } else if (is_waiting && now - fanout_sent_at >= FANOUT_TIMEOUT_NS) {
+    fanout_stats.incomplete++;
+    fanout_stats.busy_ns += now - fanout_sent_at;
+    fanout_sent_at = 0;
+    is_waiting = FALSE;
+  }
+  fio_unlock(&fanout_lock);
+
+  if (is_waiting) {
+    return FALSE;
+  }
+  if (fanout_sent < FANOUT_MESSAGES) {
+    fanout_send();
+    return FALSE;
+  }
+
+  int scraped = scrape_async(&fanout_end);
+  if (1 == scraped) {
+    return FALSE;
+  }
+  if (0 == scraped) {
+    fio_lock(&fanout_lock);
+    print_fanout(&fanout_end);
+    fio_unlock(&fanout_lock);
+  }
+  fanout_sent = 0;
+  fanout_size++;
+  if (fanout_size < FANOUT_SIZES_COUNT) {
+    return FALSE;
+  }
+  fanout_size = 0;
+  return TRUE;
+}
+
+// Opens the connections of every plateau, and once they're open and had
+// `SETTLE_SECONDS` to settle, measures the group messages of every size.
+void fanout_tick(void *arg) {
+  if (fio_trylock(&tick_lock)) {
+    return;
+  }
+  uint64_t now = UWU_monotonicNs();
+
+  if (run_started_at == 0) {
+    printf("%11s %5s %8s %10s %10s %10s %10s %15s %12s %12s\n", "subscribers",
+           "size", "messages", "incomplete", "p50(us)", "p99(us)", "max(us)",
+           "cpu/publish(us)", "out(MiB/s)", "deliveries/s");
+    run_started_at = now;
+    plateau_started_at = now;
+  }
+
+  if (plateau_reached_at == 0) {
+    if (ramp_plateau(now)) {
+      plateau_reached_at = UWU_monotonicNs();
+    }
+  } else if (now - plateau_reached_at >= SETTLE_SECONDS * 1000000000 &&
+             fanout_step(now)) {
+    next_plateau(now);
+  }
+
+  print_progress(now);
+  fio_unlock(&tick_lock);
+}
+
+/* *****************************************************************************
+Duplicates
+***************************************************************************** */
+
+// Rounds to run. Configured with `-duplicates`.
+static size_t DUPLICATE_ROUNDS = 0;
+// The prefix of the username of every round. Configured with `-name`.
+static const char *DUPLICATE_PREFIX = NULL;
+
+static size_t duplicate_round = 0;
+// Zero while the connections of the previous round are still closing.
+static uint64_t duplicate_started_at = 0;
+static size_t duplicate_refused_before = 0;
+static size_t duplicate_revoked_before = 0;
+// Rounds that left the username on none or more than one connection.
+static size_t duplicate_failures = 0;
+
+// Opens every connection at once, all with the same new username. A new name
+// on every round keeps the server from refusing it while the users of the
+// previous round are still leaving.
+void duplicates_start(uint64_t now) {
+  duplicate_refused_before = fio_atomic_add(&conn_stats.failed, 0);
+  duplicate_revoked_before = fio_atomic_add(&error_counts[USERNAME_TAKEN], 0);
+  duplicate_started_at = now;
+
+  for (size_t i = 0; i < CONNECTIONS; i++) {
+    UWU_LoadConn *conn = &conns[i];
+    conn->name_length =
+        snprintf(conn->name, sizeof(conn->name), "%.16s%d-%zu",
+                 DUPLICATE_PREFIX, (int)getpid(), duplicate_round);
+    conn->is_leaving = FALSE;
+    if (-1 == connect_one(conn)) {
+      fio_atomic_add(&conn_stats.failed, 1);
+    }
+  }
+}
+
+// Counts the connections of the round that kept the username and closes them.
+void duplicates_check() {
+  size_t open = 0;
+  for (size_t i = 0; i < CONNECTIONS; i++) {
+    UWU_LoadConn *conn = &conns[i];
+    fio_lock(&conn->lock);
+    if (NULL != conn->ws) {
+      open++;
+      conn->is_leaving = TRUE;
+      websocket_close(conn->ws);
+    }
+    fio_unlock(&conn->lock);
+  }
+
+  UWU_Bool is_ok = open == 1;
+  if (!is_ok) {
+    duplicate_failures++;
+  }
+  printf("%6zu %6zu %8zu %8zu %7s\n", duplicate_round, open,
+         fio_atomic_add(&conn_stats.failed, 0) - duplicate_refused_before,
+         fio_atomic_add(&error_counts[USERNAME_TAKEN], 0) -
+             duplicate_revoked_before,
+         is_ok ? "ok" : "FAIL");
+}
+
+// Runs every round, giving the connections `SETTLE_SECONDS` to open or be
+// refused before checking it. The next round starts once every connection of
+// the previous one closed.
+void duplicates_tick(void *arg) {
+  if (fio_trylock(&tick_lock)) {
+    return;
+  }
+  uint64_t now = UWU_monotonicNs();
+
+  if (run_started_at == 0) {
+    printf("%6s %6s %8s %8s %7s\n", "round", "open", "refused", "revoked",
+           "result");
+    run_started_at = now;
+  }
+
+  if (duplicate_started_at == 0) {
+    if (0 == fio_atomic_add(&conn_stats.open, 0)) {
+      if (duplicate_round == DUPLICATE_ROUNDS) {
+        fio_stop();
+      } else {
+        duplicates_start(now);
+      }
+    }
+  } else if (now - duplicate_started_at >= SETTLE_SECONDS * 1000000000) {
+    duplicates_check();
+    duplicate_round++;
+    duplicate_started_at = 0;
+  }
+
+  print_progress(now);
+  fio_unlock(&tick_lock);
+}
+
+/* *****************************************************************************
+Soak
+***************************************************************************** */
+
+// Samples at the start and at the end of the soak that are compared, their
+// median is used so a single noisy sample can't fail or pass it.
+#define SOAK_COMPARED_SAMPLES 3
+
+typedef struct {
+  // Seconds since the load started.
+  double at;
+  UWU_ServerSample server;
+  // Answers per second and latency percentiles since the previous sample.
+  double answers;
+  uint64_t p50;
+  uint64_t p99;
+  uint64_t p999;
+} UWU_SoakSample;
+
+// Configured with `-soak`, the mix runs for `-duration` while the server and
+// the latencies are sampled.
+static UWU_Bool SOAK = FALSE;
+// Configured with `-sample-every`.
+static size_t SAMPLE_SECONDS = 0;
+// Samples taken before this are not compared. Configured with `-warmup`.
+static size_t WARMUP_SECONDS = 0;
+// The growth allowed between the start and the end of the soak, in percent.
+// Configured with `-max-rss-growth`, `-max-alloc-growth` and `-max-p99-drift`.
+static double MAX_RSS_GROWTH = 0;
+static double MAX_ALLOC_GROWTH = 0;
+static double MAX_P99_DRIFT = 0;
+
+static UWU_SoakSample *soak_samples = NULL;
+static size_t soak_samples_count = 0;
+static size_t soak_samples_capacity = 0;
+static volatile UWU_Bool is_soak_done = FALSE;
+// All the latencies recorded until the previous sample.
+static UWU_Histogram soak_previous = {};
+static UWU_Histogram soak_window = {};
+
+// Takes a sample of the server and of the latencies since the previous one.
+void soak_sample(uint64_t now) {
+  if (soak_samples_count == soak_samples_capacity) {
+    return;
+  }
+  UWU_SoakSample *sample = &soak_samples[soak_samples_count];
+  if (-1 == scrape_metrics(&sample->server)) {
+    return;
+  }
+
+  memset(&soak_window, 0, sizeof(soak_window));
+  for (size_t i = 0; i < LOAD_KINDS_COUNT; i++) {
+    UWU_Histogram_merge(&soak_window, &kind_stats[i].latency);
+  }
+  UWU_Histogram current = soak_window;
+  UWU_Histogram_subtract(&soak_window, &soak_previous);
+  soak_previous = current;
+
+  double seconds = soak_samples_count > 0
+                       ? (now - run_started_at) / 1e9 -
+                             soak_samples[soak_samples_count - 1].at
+                       : (now - run_started_at) / 1e9;
+  sample->at = (now - run_started_at) / 1e9;
+  sample->answers = seconds > 0 ? soak_window.total / seconds : 0;
+  sample->p50 = UWU_Histogram_percentile(&soak_window, 50);
+  sample->p99 = UWU_Histogram_percentile(&soak_window, 99);
+  sample->p999 = UWU_Histogram_percentile(&soak_window, 99.9);
+  soak_samples_count++;
+
+  printf("%8.0f %10.1f %14.1f %12.0f %10.0f %10.1f %10.1f %10.1f\n",
+         sample->at, sample->server.rss / (1 << 20),
+         sample->server.allocated / (1 << 20), sample->server.allocations,
+         sample->answers, sample->p50 / 1e3, sample->p99 / 1e3,
+         sample->p999 / 1e3);
+  fflush(stdout);
+}
+
+// Samples every `SAMPLE_SECONDS` while the load runs, on its own thread so the
+// scrapes don't delay the requests.
+void *soak_sampler(void *arg) {
+  const struct timespec pause = {.tv_sec = 0, .tv_nsec = 100000000};
+  size_t next_sample = 1;
+
+  printf("%8s %10s %14s %12s %10s %10s %10s %10s\n", "seconds", "rss(MiB)",
+         "allocated(MiB)", "allocations", "answers/s", "p50(us)", "p99(us)",
+         "p99.9(us)");
+  while (!is_soak_done) {
+    nanosleep(&pause, NULL);
+    uint64_t started_at = run_started_at;
+    if (started_at == 0) {
+      continue;
+    }
+
+    uint64_t now = UWU_monotonicNs();
+    if (now - started_at >= next_sample * SAMPLE_SECONDS * 1000000000) {
+      soak_sample(now);
+      next_sample++;
+    }
+  }
+  return NULL;
+}
+
+// Returns the median of `values`, sorting them.
+double median(double *values, size_t count) {
+  for (size_t i = 1; i < count; i++) {
+    for (size_t j = i; j > 0 && values[j - 1] > values[j]; j--) {
+      double tmp = values[j];
+      values[j] = values[j - 1];
+      values[j - 1] = tmp;
+    }
+  }
+  return values[count / 2];
+}
+
+// Prints how much a value grew from the start to the end of the soak, returns
+// `FALSE` if it grew more than `limit` percent.
+UWU_Bool check_growth(const char *name, double *start, double *end,
+                      double limit) {
+  double before = median(start, SOAK_COMPARED_SAMPLES);
+  double after = median(end, SOAK_COMPARED_SAMPLES);
+  double growth = before > 0 ? (after - before) * 100 / before : 0;
+  UWU_Bool is_ok = growth <= limit;
+
+  printf("soak: %s %.0f -> %.0f (%+.1f%%, limit %.1f%%) %s\n", name, before,
+         after, growth, limit, is_ok ? "ok" : "FAILED");
+  return is_ok;
+}
+
+// Compares the first samples after the warmup with the last ones, returns
+// `FALSE` if anything grew more than allowed.
+UWU_Bool check_soak() {
+  size_t first = 0;
+  while (first < soak_samples_count &&
+         soak_samples[first].at < WARMUP_SECONDS) {
+    first++;
+  }
+  if (soak_samples_count - first < 2 * SOAK_COMPARED_SAMPLES) {
+    printf("soak: only %zu samples after the warmup, at least %d are needed "
+           "FAILED\n",
+           soak_samples_count - first, 2 * SOAK_COMPARED_SAMPLES);
+    return FALSE;
+  }
+
+  if (!is_single_worker(&soak_samples[0].server)) {
+    printf("soak: the server doesn't run a single worker FAILED\n");
+    return FALSE;
+  }
+
+  size_t last = soak_samples_count - SOAK_COMPARED_SAMPLES;
+  double start[3][SOAK_COMPARED_SAMPLES];
+  double end[3][SOAK_COMPARED_SAMPLES];
+  for (size_t i = 0; i < SOAK_COMPARED_SAMPLES; i++) {
+    start[0][i] = soak_samples[first + i].server.rss;
+    start[1][i] = soak_samples[first + i].server.allocations;
+    start[2][i] = soak_samples[first + i].p99 / 1e3;
+    end[0][i] = soak_samples[last + i].server.rss;
+    end[1][i] = soak_samples[last + i].server.allocations;
+    end[2][i] = soak_samples[last + i].p99 / 1e3;
+  }
+
+  UWU_Bool is_ok = TRUE;
+  is_ok &= check_growth("rss", start[0], end[0], MAX_RSS_GROWTH);
+  is_ok &= check_growth("allocations", start[1], end[1], MAX_ALLOC_GROWTH);
+  is_ok &= check_growth("p99(us)", start[2], end[2], MAX_P99_DRIFT);
+  return is_ok;
+}
+
+/* *****************************************************************************
+Report
+***************************************************************************** */
+
+static const char *ERROR_NAMES[USERNAME_TAKEN + 1] = {
+    "USER_NOT_FOUND",
+    "INVALID_STATUS",
+    "EMPTY_MESSAGE",
+    "USER_ALREADY_DISCONNECTED",
+    "SLOW_CONSUMER",
+    "RATE_LIMITED",
+    "TOO_MANY_WATCHED_USERS",
+    "USERNAME_TAKEN",
+};
+
+// Prints the latency percentiles of `hist` in microseconds, ending the line.
+void print_latencies(UWU_Histogram *hist) {
+  printf(" %10.0f %10.0f %10.0f %10.0f %10.0f\n",
+         UWU_Histogram_percentile(hist, 50) / 1e3,
+         UWU_Histogram_percentile(hist, 90) / 1e3,
+         UWU_Histogram_percentile(hist, 99) / 1e3,
+         UWU_Histogram_percentile(hist, 99.9) / 1e3, hist->max / 1e3);
+}
+
+void print_report(uint64_t elapsed_ns) {
+  double seconds = (double)elapsed_ns / 1e9;
+  if (seconds <= 0) {
+    seconds = 1;
+  }
+
+  if (NULL != REPLAY_PATH) {
+    printf("url=%s replay=%s speed=%g connections=%zu records=%zu\n", URL,
+           REPLAY_PATH, REPLAY_SPEED, CONNECTIONS, replay_events_count);
+  } else {
+    printf("url=%s connections=%zu rate=%zu duration=%zus size=%zu churn=%zu "
+           "seed=%s\n",
+           URL, CONNECTIONS, RATE, DURATION_SECONDS, MESSAGE_SIZE, CHURN_RATE,
+           fio_cli_get("-seed"));
+  }
+  printf("connections: opened=%zu failed=%zu closed=%zu\n", conn_stats.opened,
+         conn_stats.failed, conn_stats.closed);
+
+  printf("%-8s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "kind", "sent",
+         "answered", "lost", "answers/s", "p50(us)", "p90(us)", "p99(us)",
+         "p99.9(us)", "max(us)");
+
+  UWU_Histogram all = {};
+  size_t sent = 0;
+  size_t answered = 0;
+  for (size_t i = 0; i < LOAD_KINDS_COUNT; i++) {
+    UWU_LoadKindStats *stats = &kind_stats[i];
+    UWU_Histogram *hist = &stats->latency;
+    UWU_Histogram_merge(&all, hist);
+    sent += stats->sent;
+    answered += stats->answered;
+
+    printf("%-8s %10zu %10zu %10zu %10.0f", LOAD_KIND_NAMES[i], stats->sent,
+           stats->answered, stats->unanswered, stats->answered / seconds);
+    print_latencies(hist);
+  }
+  printf("%-8s %10zu %10zu %10s %10.0f", "all", sent, answered, "-",
+         answered / seconds);
+  print_latencies(&all);
+
+  printf("\n%-8s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "delivery",
+         "", "received", "", "received/s", "p50(us)", "p90(us)", "p99(us)",
+         "p99.9(us)", "max(us)");
+  for (size_t i = 0; i < DELIVERY_KINDS_COUNT; i++) {
+    UWU_Histogram *hist = &delivery_latency[i];
+    printf("%-8s %10s %10zu %10s %10.0f", DELIVERY_KIND_NAMES[i], "",
+           hist->total, "", hist->total / seconds);
+    print_latencies(hist);
+  }
+  if (CHURN_RATE > 0) {
+    printf("\n%-8s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "churn",
+           "started", "done", "failed", "done/s", "p50(us)", "p90(us)",
+           "p99(us)", "p99.9(us)", "max(us)");
+    printf("%-8s %10zu %10zu %10zu %10.0f", "open", churn_stats.started,
+           churn_stats.opened, churn_stats.failed,
+           churn_stats.opened / seconds);
+    print_latencies(&handshake_latency);
+    printf("%-8s %10s %10zu %10s %10.0f", "close", "", churn_stats.closed, "",
+           churn_stats.closed / seconds);
+    print_latencies(&close_latency);
+    printf("churn_skipped=%zu (due while every churn slot was busy)\n",
+           churn_stats.skipped);
+  }
+
+  printf("\nskipped=%zu (due without an open connection to send them)\n",
+         skipped_requests);
+  if (NULL != REPLAY_PATH) {
+    printf("unmeasured=%zu (replayed frames that have no answer)\n",
+           replay_unmeasured);
+  }
+
+  printf("errors:");
+  for (size_t i = 0; i <= USERNAME_TAKEN; i++) {
+    printf(" %s=%zu", ERROR_NAMES[i], error_counts[i]);
+  }
+  printf(" unknown_frames=%zu\n", unknown_frames);
+}
+
+// Writes a histogram into the file `<prefix>-<name>.hgrm`, in microseconds.
+// Empty histograms are skipped.
+void write_hgrm(const char *prefix, const char *name, UWU_Histogram *hist) {
+  if (hist->total == 0) {
+    return;
+  }
+
+  char path[PATH_MAX];
+  int length = snprintf(path, sizeof(path), "%s-%s.hgrm", prefix, name);
+  if (length < 0 || (size_t)length >= sizeof(path)) {
+    fprintf(stderr, "Error: The histogram path is too long!\n");
+    return;
+  }
+
+  FILE *out = fopen(path, "w");
+  if (NULL == out) {
+    fprintf(stderr, "Error: Failed to open `%s`: %s\n", path, strerror(errno));
+    return;
+  }
+  UWU_Histogram_printPercentiles(out, hist, 1e3);
+  fclose(out);
+  fprintf(stderr, "Info: Wrote %s\n", path);
+}
+
+// Writes every histogram with values using `prefix`.
+void write_all_hgrm(const char *prefix) {
+  for (size_t i = 0; i < LOAD_KINDS_COUNT; i++) {
+    write_hgrm(prefix, LOAD_KIND_NAMES[i], &kind_stats[i].latency);
+  }
+
+  char name[32];
+  for (size_t i = 0; i < DELIVERY_KINDS_COUNT; i++) {
+    snprintf(name, sizeof(name), "%s-delivery", DELIVERY_KIND_NAMES[i]);
+    write_hgrm(prefix, name, &delivery_latency[i]);
+  }
+  write_hgrm(prefix, "handshake", &handshake_latency);
+  write_hgrm(prefix, "close", &close_latency);
+}
+
+/* *****************************************************************************
+CLI
+***************************************************************************** */
+
+// Reads the weight of every kind of request from the CLI.
+// Returns -1 if none of them has a weight.
+//
+// A probe only sends messages, so their delivery isn't delayed by the other
+// requests.
+int read_weights() {
+  static const char *FLAGS[LOAD_KINDS_COUNT] = {
+      "-group", "-dm", "-history", "-list", "-status", "-user"};
+  UWU_Bool is_probe = fio_cli_get_bool("-probe");
+
+  TOTAL_WEIGHT = 0;
+  for (size_t i = 0; i < LOAD_KINDS_COUNT; i++) {
+    UWU_Bool is_message = i == LOAD_GROUP_MESSAGE || i == LOAD_DIRECT_MESSAGE;
+    int weight = is_probe && !is_message ? 0 : fio_cli_get_i(FLAGS[i]);
+    WEIGHTS[i] = weight < 0 ? 0 : weight;
+    TOTAL_WEIGHT += WEIGHTS[i];
+  }
+  return TOTAL_WEIGHT == 0 ? -1 : 0;
+}
+
+int main(int argc, char const *argv[]) {
+  fio_cli_start(
+      argc, argv, 0, 0,
+      "Opens many connections to an UwuChat server and sends a mix of "
+      "requests at a fixed rate, reporting the throughput, errors and "
+      "latencies.",
+      FIO_CLI_PRINT_HEADER("Target:"),
+      FIO_CLI_STRING("-url -u the server URL, ending with `/`. Connections "
+                     "are spread over a comma separated list of URLs. "
+                     "default: ws://127.0.0.1:8080/"),
+      FIO_CLI_INT("-connections -c connections to open, each with its own "
+                  "username. default: 100"),
+      FIO_CLI_INT("-connect-rate -cr connections opened per second, 0 opens "
+                  "them all at once. default: 50"),
+      FIO_CLI_STRING("-name -n prefix of the usernames. default: load"),
+      FIO_CLI_PRINT_HEADER("Load:"),
+      FIO_CLI_INT("-rate -r requests per second, across all the connections. "
+                  "default: 1000"),
+      FIO_CLI_INT("-duration -d seconds to run once every connection is "
+                  "open. default: 30"),
+      FIO_CLI_INT("-churn connections per second opened and closed by new "
+                  "users on top of the open ones, measuring how long the "
+                  "handshake and the close take. default: 0"),
+      FIO_CLI_INT("-size -s bytes of every message, 32 to 255. default: 32"),
+      FIO_CLI_INT("-seed random seed, keep it the same to compare runs. "
+                  "default: 1"),
+      FIO_CLI_INT("-threads -t number of threads. default: 1"),
+      FIO_CLI_BOOL("-probe only send messages (group and DM), measuring how "
+                   "long they take to be delivered."),
+      FIO_CLI_STRING("-replay replays a capture written by the server with "
+                     "`-capture` instead of sending the mix. Only `-url`, "
+                     "`-threads` and `-hgrm` apply."),
+      FIO_CLI_STRING("-speed how fast to replay the capture, 2 is twice as "
+                     "fast. default: 1"),
+      FIO_CLI_STRING("-idle opens idle connections up to every amount of a "
+                     "comma separated list (like 10000,50000,100000) and "
+                     "reports the memory and idle detector CPU the server "
+                     "uses at each one, read from `/metrics`."),
+      FIO_CLI_STRING("-fanout opens connections up to every amount of a "
+                     "comma separated list (like 10,1000,50000) and measures "
+                     "how long group messages take to reach all of them and "
+                     "the server CPU each one costs."),
+      FIO_CLI_STRING("-fanout-sizes comma separated sizes of the `-fanout` "
+                     "messages, 1 to 255. default: 1,32,128,255"),
+      FIO_CLI_INT("-fanout-messages messages sent one at a time for every "
+                  "`-fanout` size. default: 100"),
+      FIO_CLI_INT("-duplicates opens every connection at once with the same "
+                  "username this many rounds, failing if the server lets "
+                  "more or less than one of them keep it. Use it against a "
+                  "`-partitioned` server."),
+      FIO_CLI_INT("-settle seconds to wait on every `-idle` or `-fanout` "
+                  "plateau before measuring it, or on every `-duplicates` "
+                  "round before checking it. default: 30"),
+      FIO_CLI_STRING("-hgrm every latency histogram is written into "
+                     "`<prefix>-<kind>.hgrm` using this prefix, on the "
+                     "HdrHistogram format."),
+      FIO_CLI_PRINT_HEADER("Soak:"),
+      FIO_CLI_BOOL("-soak samples the server memory and the latencies while "
+                   "the mix runs, failing if they grow more than allowed. "
+                   "Use a long `-duration`."),
+      FIO_CLI_INT("-sample-every seconds between soak samples. default: 60"),
+      FIO_CLI_INT("-warmup seconds of samples ignored when comparing the "
+                  "start and the end of the soak. default: 300"),
+      FIO_CLI_STRING("-max-rss-growth percent the server RSS can grow. "
+                     "default: 10"),
+      FIO_CLI_STRING("-max-alloc-growth percent the server live allocations "
+                     "can grow. default: 10"),
+      FIO_CLI_STRING("-max-p99-drift percent the p99 latency can grow. "
+                     "default: 50"),
+      FIO_CLI_PRINT_HEADER("Mix (relative weights):"),
+      FIO_CLI_INT("-group SEND_MESSAGE to the group chat. default: 40"),
+      FIO_CLI_INT("-dm SEND_MESSAGE to another connection. default: 30"),
+      FIO_CLI_INT("-history GET_MESSAGES of the group or a DM. default: 10"),
+      FIO_CLI_INT("-list LIST_USERS. default: 10"),
+      FIO_CLI_INT("-status CHANGE_STATUS between ACTIVE and BUSY. default: "
+                  "10"),
+      FIO_CLI_INT("-user GET_USER of another connection. default: 0"));
+
+  /* CLI set functions (unlike fio_cli_start) ignores aliases */
+  fio_cli_set_default("-url", "ws://127.0.0.1:8080/");
+  fio_cli_set_default("-u", "ws://127.0.0.1:8080/");
+
+  fio_cli_set_default("-connections", "100");
+  fio_cli_set_default("-c", "100");
+
+  fio_cli_set_default("-connect-rate", "50");
+  fio_cli_set_default("-cr", "50");
+
+  fio_cli_set_default("-name", "load");
+  fio_cli_set_default("-n", "load");
+
+  fio_cli_set_default("-rate", "1000");
+  fio_cli_set_default("-r", "1000");
+
+  fio_cli_set_default("-duration", "30");
+  fio_cli_set_default("-d", "30");
+
+  fio_cli_set_default("-size", "32");
+  fio_cli_set_default("-s", "32");
+
+  fio_cli_set_default("-threads", "1");
+  fio_cli_set_default("-t", "1");
+
+  fio_cli_set_default("-seed", "1");
+  fio_cli_set_default("-churn", "0");
+  fio_cli_set_default("-settle", "30");
+  fio_cli_set_default("-duplicates", "0");
+  fio_cli_set_default("-fanout-sizes", "1,32,128,255");
+  fio_cli_set_default("-fanout-messages", "100");
+  fio_cli_set_default("-sample-every", "60");
+  fio_cli_set_default("-warmup", "300");
+  fio_cli_set_default("-max-rss-growth", "10");
+  fio_cli_set_default("-max-alloc-growth", "10");
+  fio_cli_set_default("-max-p99-drift", "50");
+  fio_cli_set_default("-speed", "1");
+
+  fio_cli_set_default("-group", "40");
+  fio_cli_set_default("-dm", "30");
+  fio_cli_set_default("-history", "10");
+  fio_cli_set_default("-list", "10");
+  fio_cli_set_default("-status", "10");
+  fio_cli_set_default("-user", "0");
+
+  URL = (char *)fio_cli_get("-url");
+  // `strtok` writes into the list, and `URL` is still printed whole.
+  static char urls[4096];
+  snprintf(urls, sizeof(urls), "%s", URL);
+  if (strlen(URL) >= sizeof(urls) || -1 == split_urls(urls)) {
+    fprintf(stderr, "Error: Expected between 1 and %d URLs!\n", MAX_URLS);
+    return 1;
+  }
+  int connections = fio_cli_get_i("-connections");
+  int connect_rate = fio_cli_get_i("-connect-rate");
+  int rate = fio_cli_get_i("-rate");
+  int duration = fio_cli_get_i("-duration");
+  int size = fio_cli_get_i("-size");
+  int threads = fio_cli_get_i("-threads");
+  const char *name = fio_cli_get("-name");
+
+  if (threads <= 0) {
+    fprintf(stderr, "Error: Threads must be positive!\n");
+    return 1;
+  }
+
+  REPLAY_PATH = fio_cli_get("-replay");
+  if (NULL != REPLAY_PATH) {
+    char *end = NULL;
+    REPLAY_SPEED = strtod(fio_cli_get("-speed"), &end);
+    if (*end != '\0' || !(REPLAY_SPEED > 0)) {
+      fprintf(stderr, "Error: The replay speed must be positive!\n");
+      return 1;
+    }
+    if (-1 == load_replay()) {
+      UWU_free(replay_file);
+      UWU_free(replay_events);
+      UWU_free(conns);
+      return 1;
+    }
+
+    fprintf(stderr, "Info: Replaying %zu records of %zu connections to %s...\n",
+            replay_events_count, CONNECTIONS, URL);
+    fio_run_every(TICK_MS, 0, replay_tick, NULL, NULL);
+    fio_start(.threads = threads);
+
+    print_report(UWU_monotonicNs() - run_started_at);
+    if (fio_cli_get("-hgrm")) {
+      write_all_hgrm(fio_cli_get("-hgrm"));
+    }
+
+    UWU_free(replay_file);
+    UWU_free(replay_events);
+    UWU_free(conns);
+    fio_cli_end();
+    return 0;
+  }
+
+  if (connections <= 0 || rate <= 0 || duration <= 0 || threads <= 0) {
+    fprintf(stderr, "Error: Connections, rate, duration and threads must be "
+                    "positive!\n");
+    return 1;
+  }
+  if (size < (int)MIN_MESSAGE_SIZE || size > (int)MAX_MESSAGE_SIZE) {
+    fprintf(stderr, "Error: The message size must be between %d and %d!\n",
+            MIN_MESSAGE_SIZE, MAX_MESSAGE_SIZE);
+    return 1;
+  }
+  if (-1 == read_weights()) {
+    fprintf(stderr, "Error: At least one kind of request needs a weight!\n");
+    return 1;
+  }
+
+  CONNECTIONS = connections;
+  CONNECT_RATE = connect_rate < 0 ? 0 : connect_rate;
+  RATE = rate;
+  DURATION_SECONDS = duration;
+  MESSAGE_SIZE = size;
+  int churn = fio_cli_get_i("-churn");
+  CHURN_RATE = churn < 0 ? 0 : churn;
+
+  SOAK = fio_cli_get_bool("-soak");
+  int sample_seconds = fio_cli_get_i("-sample-every");
+  int warmup_seconds = fio_cli_get_i("-warmup");
+  MAX_RSS_GROWTH = strtod(fio_cli_get("-max-rss-growth"), NULL);
+  MAX_ALLOC_GROWTH = strtod(fio_cli_get("-max-alloc-growth"), NULL);
+  MAX_P99_DRIFT = strtod(fio_cli_get("-max-p99-drift"), NULL);
+  if (SOAK && (sample_seconds <= 0 || warmup_seconds < 0)) {
+    fprintf(stderr, "Error: The soak sample interval must be positive!\n");
+    return 1;
+  }
+  SAMPLE_SECONDS = sample_seconds;
+  WARMUP_SECONDS = warmup_seconds;
+  int settle = fio_cli_get_i("-settle");
+  SETTLE_SECONDS = settle < 0 ? 0 : settle;
+  if (fio_cli_get("-idle")) {
+    int count = read_amounts(fio_cli_get("-idle"), PLATEAUS, MAX_PLATEAUS);
+    if (-1 == count) {
+      fprintf(stderr, "Error: `-idle` must be a growing list of amounts of "
+                      "connections, up to %d!\n",
+              MAX_PLATEAUS);
+      return 1;
+    }
+    PLATEAUS_COUNT = count;
+    CONNECTIONS = PLATEAUS[PLATEAUS_COUNT - 1];
+    CHURN_RATE = 0;
+  } else if (fio_cli_get("-fanout")) {
+    int count = read_amounts(fio_cli_get("-fanout"), PLATEAUS, MAX_PLATEAUS);
+    int sizes_count = read_amounts(fio_cli_get("-fanout-sizes"), FANOUT_SIZES,
+                                   MAX_FANOUT_SIZES);
+    int messages = fio_cli_get_i("-fanout-messages");
+    if (-1 == count || -1 == sizes_count || messages <= 0 ||
+        FANOUT_SIZES[sizes_count - 1] > MAX_MESSAGE_SIZE) {
+      fprintf(stderr, "Error: `-fanout` and `-fanout-sizes` must be growing "
+                      "lists of up to %d amounts, with sizes up to %d!\n",
+              MAX_PLATEAUS, MAX_MESSAGE_SIZE);
+      return 1;
+    }
+    PLATEAUS_COUNT = count;
+    FANOUT_SIZES_COUNT = sizes_count;
+    FANOUT_MESSAGES = messages;
+    CONNECTIONS = PLATEAUS[PLATEAUS_COUNT - 1];
+    CHURN_RATE = 0;
+  } else if (fio_cli_get_i("-duplicates") > 0) {
+    DUPLICATE_ROUNDS = fio_cli_get_i("-duplicates");
+    DUPLICATE_PREFIX = name;
+    CHURN_RATE = 0;
+  }
+  // Zero would get xorshift stuck.
+  rng_state = (uint64_t)fio_cli_get_i("-seed") * 2654435761ULL + 1;
+
+  conns = UWU_calloc(UWU_ALLOC_USERS, CONNECTIONS, sizeof(UWU_LoadConn));
+  if (NULL == conns) {
+    fprintf(stderr, "Error: Failed to allocate %zu connections!\n",
+            CONNECTIONS);
+    return 1;
+  }
+
+  // Enough slots for churns that take up to a couple of seconds.
+  churn_slots = CHURN_RATE > 0 ? 2 * CHURN_RATE + 16 : 0;
+  if (churn_slots > 0) {
+    churn_conns =
+        UWU_calloc(UWU_ALLOC_USERS, churn_slots, sizeof(UWU_LoadConn));
+    if (NULL == churn_conns) {
+      fprintf(stderr, "Error: Failed to allocate the churn connections!\n");
+      UWU_free(conns);
+      return 1;
+    }
+  }
+  for (size_t i = 0; i < churn_slots; i++) {
+    churn_conns[i].idx = i;
+    churn_conns[i].is_churn = TRUE;
+  }
+
+  // The pid keeps the names unique when many load generators share a server.
+  for (size_t i = 0; i < CONNECTIONS; i++) {
+    UWU_LoadConn *conn = &conns[i];
+    conn->idx = i;
+    int length = snprintf(conn->name, sizeof(conn->name), "%.16s%d-%zu", name,
+                          (int)getpid(), i);
+    if (length < 0 || (size_t)length >= sizeof(conn->name)) {
+      fprintf(stderr, "Error: The username prefix is too long!\n");
+      UWU_free(conns);
+      UWU_free(churn_conns);
+      return 1;
+    }
+    conn->name_length = length;
+  }
+
+  fprintf(stderr, "Info: Opening %zu connections to %s...\n", CONNECTIONS,
+          URL);
+  ramp_started_at = UWU_monotonicNs();
+  if (PLATEAUS_COUNT > 0) {
+    fio_run_every(TICK_MS, 0, FANOUT_SIZES_COUNT > 0 ? fanout_tick : idle_tick,
+                  NULL, NULL);
+    fio_start(.threads = threads);
+
+    if (current_plateau < PLATEAUS_COUNT) {
+      fprintf(stderr, "Error: Stopped before measuring every plateau!\n");
+    }
+    UWU_free(conns);
+    fio_cli_end();
+    return current_plateau < PLATEAUS_COUNT ? 1 : 0;
+  }
+
+  if (DUPLICATE_ROUNDS > 0) {
+    fprintf(stderr, "Info: Opening %zu connections with the same username, "
+                    "%zu times...\n",
+            CONNECTIONS, DUPLICATE_ROUNDS);
+    fio_run_every(TICK_MS, 0, duplicates_tick, NULL, NULL);
+    fio_start(.threads = threads);
+
+    if (duplicate_round < DUPLICATE_ROUNDS) {
+      fprintf(stderr, "Error: Stopped before running every round!\n");
+    } else {
+      printf("%zu of %zu rounds left the username on a single connection.\n",
+             DUPLICATE_ROUNDS - duplicate_failures, DUPLICATE_ROUNDS);
+    }
+    UWU_free(conns);
+    fio_cli_end();
+    return duplicate_round < DUPLICATE_ROUNDS || duplicate_failures > 0 ? 1
+                                                                        : 0;
+  }
+
+  pthread_t sampler;
+  if (SOAK) {
+    soak_samples_capacity = DURATION_SECONDS / SAMPLE_SECONDS + 1;
+    soak_samples = UWU_calloc(UWU_ALLOC_DIAGNOSTICS, soak_samples_capacity,
+                              sizeof(UWU_SoakSample));
+    if (NULL == soak_samples ||
+        0 != pthread_create(&sampler, NULL, soak_sampler, NULL)) {
+      fprintf(stderr, "Error: Failed to start the soak sampler!\n");
+      UWU_free(soak_samples);
+      UWU_free(conns);
+      UWU_free(churn_conns);
+      return 1;
+    }
+  }
+
+  fio_run_every(TICK_MS, 0, tick, NULL, NULL);
+  fio_start(.threads = threads);
+
+  UWU_Bool is_soak_ok = TRUE;
+  if (SOAK) {
+    is_soak_done = TRUE;
+    pthread_join(sampler, NULL);
+  }
+
+  uint64_t ended_at = UWU_monotonicNs();
+  if (run_started_at == 0) {
+    fprintf(stderr, "Error: Stopped before every connection was open!\n");
+    run_started_at = ended_at;
+  }
+  print_report(ended_at - run_started_at);
+  if (fio_cli_get("-hgrm")) {
+    write_all_hgrm(fio_cli_get("-hgrm"));
+  }
+  if (SOAK) {
+    is_soak_ok = check_soak();
+  }
+
+  UWU_free(soak_samples);
+  UWU_free(conns);
+  UWU_free(churn_conns);
+  fio_cli_end();
+  return is_soak_ok ? 0 : 1;
+}